@@ -85,11 +85,12 @@ def received_data(data):
 	# Parse line and detect data
 	# Position	(.*)\>APECAN(.*?):\/([0-9]{6}h)(.{13})(.*?)\|(.*)\|
 	# Image		(.*)\>APECAN(.*?):\/([0-9]{6}h)(.{13})I(.*)
+	# Parity	(.*)\>APECAN(.*?):\/([0-9]{6}h)(.{13})P(.*)
 	# Log		(.*)\>APECAN(.*?):\/([0-9]{6}h)(.{13})L(.*)
 
 	all = re.search("(.*)\>APECAN(.*?):", data)
 	pos = re.search("(.*)\>APECAN(.*?):\!(.{13})(.*?)\|(.*)\|", data)
-	dat = re.search("(.*)\>APECAN(.*?):\{\{(I|L)(.*)", data)
+	dat = re.search("(.*)\>APECAN(.*?):\{\{(I|L|P)(.*)", data)
 
 	if pos or dat:
 		# Debug
@@ -114,6 +115,8 @@ def received_data(data):
 
 			if typ is 'I': # Image packet
 				image.insert_image(sqlite, rxer, call, data)
+			elif typ is 'P': # Image parity packet
+				image.insert_parity(sqlite, rxer, call, data)
 			elif typ is 'L': # Log packet
 				position.insert_position(sqlite, call, data, 'log')
 
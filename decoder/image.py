@@ -59,19 +59,43 @@ def imgproc():
 		time.sleep(1)
 
 w = time.time()
-def insert_image(sqlite, receiver, call, data_b91):
-	global imageProcessor,imageData,w
+parityData = {} # Parity packets of packet groups not restored yet
 
-	data = base91.decode(data_b91)
-	if len(data) != 174:
-		return # APRS message has invalid type or length (or both)
+def find_image(cur, call, imageID, packetID, data):
+	""" Returns the server ID of the image the packet belongs to """
+	timd = int(datetime.now().timestamp())
 
-	cur = sqlite.cursor()
+	# Find image ID (or generate new one)
+	_id = None
+	cur.execute("SELECT id FROM image WHERE call = ? AND imageID = ? AND rxtime+15*60 >= ? ORDER BY rxtime DESC LIMIT 1", (call, imageID, timd))
+	fetch = cur.fetchall()
+	if len(fetch):
+		_id = fetch[0][0]
 
-	# Decode various meta data
-	imageID  = data[0]
-	packetID = (data[1] << 8) | data[2]
-	data = binascii.hexlify(data[3:]).decode("ascii")
+	# Packets may arrive in any order (progressive transmission), so a new image
+	# with the same image ID is detected by a packet ID received with other data
+	if _id is not None:
+		cur.execute("SELECT data FROM image WHERE id = ? AND packetID = ?", (_id, packetID))
+		fetch = cur.fetchall()
+		if len(fetch) and fetch[0][0] != data:
+			_id = None
+
+	if _id is None:
+		# Generate ID
+		cur.execute("SELECT id+1 FROM image ORDER BY id DESC LIMIT 1")
+		fetch = cur.fetchall()
+		if len(fetch):
+			_id = fetch[0][0]
+		else: # No entries in the database
+			_id = 0
+
+	return _id
+
+def insert_packet(sqlite, call, imageID, packetID, payload, _id=None):
+	global imageProcessor,imageData,w
+
+	cur = sqlite.cursor()
+	data = binascii.hexlify(payload).decode("ascii")
 
 	# Encode callsign (ensure callsign has no more than 6 chars)
 	bcall = call.split('-') # Split callsign and SSID
@@ -89,22 +113,8 @@ def insert_image(sqlite, receiver, call, data_b91):
 
 	timd = int(datetime.now().timestamp())
 
-	# Find image ID (or generate new one)
-	_id = None
-	cur.execute("SELECT id,packetID FROM image WHERE call = ? AND imageID = ? AND rxtime+15*60 >= ? ORDER BY rxtime DESC LIMIT 1", (call, imageID, timd))
-	fetch = cur.fetchall()
-	if len(fetch):
-		_id = fetch[0][0]
-		lastPacketId = fetch[0][1]
-
-	if _id is None or lastPacketId > packetID:
-		# Generate ID
-		cur.execute("SELECT id+1 FROM image ORDER BY id DESC LIMIT 1")
-		fetch = cur.fetchall()
-		if len(fetch):
-			_id = fetch[0][0]
-		else: # No entries in the database
-			_id = 0
+	if _id is None:
+		_id = find_image(cur, call, imageID, packetID, data)
 
 	# Debug
 	print('Received image packet Call=%s ImageID=%d PacketID=%d ServerID=%d' % (call, imageID, packetID, _id))
@@ -121,7 +131,8 @@ def insert_image(sqlite, receiver, call, data_b91):
 		w = time.time()
 
 	with lock:
-		cur.execute("SELECT GROUP_CONCAT('55' || data || '"+(144*'0')+"', '') FROM image WHERE id = ? GROUP BY id ORDER BY packetID", (_id,))
+		# The SSDV decoder requires the packets in the order of their IDs
+		cur.execute("SELECT GROUP_CONCAT('55' || data || '"+(144*'0')+"', '') FROM (SELECT data FROM image WHERE id = ? ORDER BY packetID)", (_id,))
 		data = cur.fetchall()[0][0]
 		imageData[_id] = (call, binascii.unhexlify(data))
 
@@ -129,3 +140,68 @@ def insert_image(sqlite, receiver, call, data_b91):
 		imageProcessor = threading.Thread(target=imgproc)
 		imageProcessor.start()
 
+def restore_packets(sqlite, call, imageID):
+	""" Restores a lost packet of each packet group which has received all other packets and its parity packet """
+	cur = sqlite.cursor()
+	timd = int(datetime.now().timestamp())
+
+	for key in list(parityData.keys()):
+		(pcall, pimageID, first) = key
+		if pcall != call or pimageID != imageID:
+			continue
+		(count, parity, rxtime) = parityData[key]
+		if rxtime+15*60 < timd: # Image is outdated
+			del parityData[key]
+			continue
+
+		cur.execute("SELECT id FROM image WHERE call = ? AND imageID = ? AND packetID >= ? AND packetID < ? AND rxtime+15*60 >= ? ORDER BY rxtime DESC LIMIT 1", (call, imageID, first, first+count, timd))
+		fetch = cur.fetchall()
+		if not len(fetch):
+			continue # No packet of this group received yet
+		_id = fetch[0][0]
+
+		cur.execute("SELECT packetID,data FROM image WHERE id = ? AND packetID >= ? AND packetID < ?", (_id, first, first+count))
+		packets = cur.fetchall()
+		if len(packets) == count: # Group complete
+			del parityData[key]
+		if len(packets) != count-1: # Nothing to restore or too many packets lost
+			continue
+
+		# XOR of the parity and the received packets is the lost packet
+		payload = bytearray(parity)
+		for packetID,data in packets:
+			for i,b in enumerate(binascii.unhexlify(data)[8:8+len(payload)]):
+				payload[i] ^= b
+
+		packetID = (set(range(first, first+count)) - set(p[0] for p in packets)).pop()
+		print('Restored image packet Call=%s ImageID=%d PacketID=%d' % (call, imageID, packetID))
+		insert_packet(sqlite, call, imageID, packetID, bytes(payload), _id)
+		del parityData[key]
+
+def insert_image(sqlite, receiver, call, data_b91):
+	data = base91.decode(data_b91)
+	if len(data) != 174:
+		return # APRS message has invalid type or length (or both)
+
+	# Decode various meta data
+	imageID  = data[0]
+	packetID = (data[1] << 8) | data[2]
+
+	insert_packet(sqlite, call, imageID, packetID, data[3:])
+	restore_packets(sqlite, call, imageID)
+
+def insert_parity(sqlite, receiver, call, data_b91):
+	data = base91.decode(data_b91)
+	if len(data) != 175:
+		return # APRS message has invalid type or length (or both)
+
+	# Decode various meta data
+	imageID  = data[0]
+	first    = (data[1] << 8) | data[2]
+	count    = data[3]
+
+	print('Received parity packet Call=%s ImageID=%d PacketID=%d-%d' % (call, imageID, first, first+count-1))
+
+	parityData[(call, imageID, first)] = (count, data[4:], int(datetime.now().timestamp()))
+	restore_packets(sqlite, call, imageID)
+
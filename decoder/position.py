@@ -2,10 +2,14 @@ from datetime import datetime,timedelta,timezone
 import sqlite3
 import base91
 import struct
+import binascii
 
 def insert_position(sqlite, call, comm, typ):
 	# Decode comment
 	data = base91.decode(comm)
+	if len(data) >= 76 and struct.unpack('I', data[72:76])[0] != binascii.crc32(data[:72]) & 0xffffffff:
+		print('Received %s packet with invalid CRC Call=%s' % (typ, call))
+		return
 	(adc_vsol,adc_vbat,pac_vsol,pac_vbat,pac_pbat,pac_psol,light_intensity,
 	 gps_lock,gps_sats,gps_ttff,gps_pdop,gps_alt,gps_lat,
 	 gps_lon,sen_i1_press,sen_e1_press,sen_e2_press,sen_i1_temp,sen_e1_temp,
@@ -41,6 +41,12 @@
  * init_delay			int				Initial delay (in ms) before the module starts. This might be useful if you dont want to transmit so many APRS packets
  * (default 0ms)						at the same time on the APRS network. This option is optional. It will be 0ms if not set.
  *
+ * tx_priority			int(1-255)		Priority at which the radio transmits the packets of this module if packets of several modules are waiting. Higher
+ * (default 3)							values are transmitted first. Packets with the same modulation and frequency are transmitted back to back.
+ *
+ * tx_deadline			int				Max. time (in ms) a packet should wait for the radio. Packets which have exceeded this time are transmitted before
+ * (default 10000ms)					all other packets regardless of their priority.
+ *
  * trigger.type			trigger_type_t	Event at which this module is triggered to transmit. This option will be TRIG_ONCE if not set.
  * (default TRIG_ONCE)					Possible options:
  *										- TRIG_ONCE			Trigger once and never again (e.g. transmit specific position packet only at startup)
@@ -69,6 +75,10 @@
  * aprs_conf.preamble	int				AFSK or 2GFSK preamble length (in ms). This value is required while its default is 0ms (and this would simply not work ;-) )
  * (required)
  *
+ * aprs_conf.fx25		int				FX.25 forward error correction: Amount of Reed-Solomon check bytes (16, 32 or 64) added to each
+ * (optional)							frame. Receivers without FX.25 support decode the frame as usual. Frames which are too long for
+ * 										FX.25 (more than 239 bytes after bit stuffing) are sent as plain AX.25. (default: 0, disabled)
+ *
  * aprs_conf.tel[0-4]	telemetry_t		There are numerous telemetry values which can be sent in the APRS position packet. One packet can contain 5 values.
  * (required)							There are possible options:
  * 										- TEL_SATS		GPS Satellites
@@ -211,6 +221,12 @@
  * init_delay			int				Initial delay (in ms) before the module starts. This might be useful if you dont want to transmit so many APRS packets
  * (default 0ms)						at the same time on the APRS network. This option is optional. It will be 0ms if not set.
  *
+ * tx_priority			int(1-255)		Priority at which the radio transmits the packets of this module if packets of several modules are waiting. Higher
+ * (default 1)							values are transmitted first. By default image packets give way to position and log packets.
+ *
+ * tx_deadline			int				Max. time (in ms) a packet should wait for the radio. Packets which have exceeded this time are transmitted before
+ * (default 600000ms)					all other packets regardless of their priority.
+ *
  * trigger.type			trigger_type_t	Event at which this module is triggered to transmit. This option will be TRIG_ONCE if not set.
  * (default TRIG_ONCE)					Possible options:
  *										- TRIG_ONCE			Trigger once and never again (e.g. transmit specific position packet only at startup)
@@ -238,11 +254,52 @@
  *										- RES_XGA	XGA Resolution (1204x768px)
  *										- RES_UXGA	UXGA Resolution (1600x1200px)
  *										- RES_MAX	The module samples the highest resolution which fits into ssdv_conf.ram_buffer.
+ *										- RES_AUTO	Like RES_MAX but the module also reduces resolution and quality (down to 2) until the
+ *													image can be transmitted within ssdv_conf.airtime. The image sizes are learned
+ *													from the recent images.
+ *
+ * ssdv_conf.airtime	int				Maximum transmission time of an image in seconds (RES_AUTO only, default: 0, no limit)
  *
  * ssdv_conf.redundantTx	bool		Enables redudant packet transmission if set to true. This option will enable the packets to be transmitted twice.
  *
+ * ssdv_conf.parity_group	int		Sends a parity packet after each group of parity_group packets (APRS only). The decoder can restore one
+ *										lost packet per group. A group of 5 packets costs 1.2 times the airtime of the image, compared to 2 times
+ *										with ssdv_conf.redundantTx. Parity packets ('P') are only understood by the decoder of this
+ *										repository. (default: 0, no parity packets)
+ *
+ * ssdv_conf.stream	bool			Encodes the image to SSDV while the camera is sampling (requires OV5640_USE_DMA_DBM). The camera writes into a
+ *										small ring at the end of ssdv_conf.ram_buffer and the SSDV packets are stored in the rest of it. Since the
+ *										packets are smaller than the JPEG image, higher resolutions fit into the buffer. If the image can't be
+ *										streamed (e.g. the encoder doesn't keep up with the camera), a normal picture is taken. (default: false)
+ *
+ * ssdv_conf.pipeline	bool			Captures the next image while the current one is transmitted, so there is no pause between two images.
+ *										ssdv_conf.ram_buffer is split into two halves, one for each image. Requires trigger.type TRIG_CONTINUOUSLY
+ *										and enough heap for a 4kb capture thread (captures without pipelining otherwise). (default: false)
+ *
  * ssdv_conf.quality	int(0-7)		Quality (quantization) of the JPEG algorithm. It can be set from 0 (low quality) to 7 (high quality). (Recommended: 4)
  *
+ * ssdv_conf.burst	int				Frames captured per image. Every frame is scored (brightness, contrast and detail) and only the best one is
+ *										transmitted. The buffer (or the half of it in pipelined mode) is split in two for the best and the
+ *										current frame. (default: 0, single frame)
+ *
+ * ssdv_conf.min_score	int(0-100)		Images of a burst scoring lower are not transmitted at all (e.g. darkness or plain sky). A dark image
+ *										scores about 5, a normal one 60-100. (default: 0, transmit every image)
+ *
+ * ssdv_conf.thumbnail	int(0,1,2,4)	Transmits a preview of the image before the image itself. The thumbnail is downscaled from the DCT
+ *										coefficients of the captured JPEG (1: 1/8 scale, 2: 1/4, 4: 1/2), so no second picture is taken. It is
+ *										transmitted as a separate SSDV image with its own image ID. Not available in streaming mode, the buffer
+ *										behind the image has to hold the thumbnail (45kb at 1/8 scale in UXGA). (default: 0, no thumbnail)
+ *
+ * ssdv_conf.progressive	bool		Transmits the SSDV packets in a spread-out order: The image is split into up to 32 chunks of packets
+ *										which are sent in bit-reversed order (first, middle, first quarter, third quarter, ...). If the transmission
+ *										is cut off or packets are lost, the received ones still cover the whole image roughly. The packet IDs keep
+ *										the raster order, so decoders sorting the packets by ID (like the decoder in this repository) show the
+ *										image as usual. The image is encoded twice. (default: false)
+ *
+ * ssdv_conf.match_dqt	bool			Sets the camera quantization to the one of ssdv_conf.quality. The SSDV encoder copies the coefficients of the
+ *										camera without requantization if the tables match (exact at quality 4, close at the others), which
+ *										is faster and avoids a second rounding of the image. (default: false)
+ *
  * ============================== The following options are needed if protocol == PROT_APRS_AFSK or protocol == PROT_APRS_2GFSK ===============================
  *
  * aprs_conf.callsign	string			Your amateur radio callsign (this requires an amateur radio license). This callsign will be used in the APRS protocol.
@@ -257,6 +314,10 @@
  * aprs_conf.preamble	int				AFSK or 2GFSK preamble length (in ms). This value is required while its default is 0ms (and this would simply not work ;-) )
  * (required)
  *
+ * aprs_conf.fx25		int				FX.25 forward error correction: Amount of Reed-Solomon check bytes (16, 32 or 64) added to each
+ * (optional)							frame. Receivers without FX.25 support decode the frame as usual. Frames which are too long for
+ * 										FX.25 (more than 239 bytes after bit stuffing) are sent as plain AX.25. (default: 0, disabled)
+ *
  * ============================================= The following options are needed if protocol == PROT_APRS_2GFSK ==============================================
  *
  * gfsk_conf.speed		int				2GFSK speed. Following values have been tested successfully: 9600, 19200.
@@ -320,6 +381,12 @@
  * init_delay			int				Initial delay (in ms) before the module starts. This might be useful if you dont want to transmit so many APRS packets
  * (default 0ms)						at the same time on the APRS network. This option is optional. It will be 0ms if not set.
  *
+ * tx_priority			int(1-255)		Priority at which the radio transmits the packets of this module if packets of several modules are waiting. Higher
+ * (default 2)							values are transmitted first. By default log packets give way to position packets.
+ *
+ * tx_deadline			int				Max. time (in ms) a packet should wait for the radio. Packets which have exceeded this time are transmitted before
+ * (default 60000ms)					all other packets regardless of their priority.
+ *
  * trigger.type			trigger_type_t	Event at which this module is triggered to transmit. This option will be TRIG_ONCE if not set.
  * (default TRIG_ONCE)					Possible options:
  *										- TRIG_ONCE			Trigger once and never again (e.g. transmit specific position packet only at startup)
@@ -343,6 +410,10 @@
  * aprs_conf.preamble	int				AFSK or 2GFSK preamble length (in ms). This value is required while its default is 0ms (and this would simply not work ;-) )
  * (required)
  *
+ * aprs_conf.fx25		int				FX.25 forward error correction: Amount of Reed-Solomon check bytes (16, 32 or 64) added to each
+ * (optional)							frame. Receivers without FX.25 support decode the frame as usual. Frames which are too long for
+ * 										FX.25 (more than 239 bytes after bit stuffing) are sent as plain AX.25. (default: 0, disabled)
+ *
  * ============================================= The following options are needed if protocol == PROT_APRS_2GFSK ==============================================
  *
  * gfsk_conf.speed		int				2GFSK speed. Following values have been tested successfully: 9600, 19200.
@@ -10,8 +10,11 @@
 #include "board.h"
 #include "debug.h"
 #include "padc.h"
+#include "radio.h"
 #include <string.h>
 
+#define EOI_SEARCH_RANGE	4096	// Bytes before the end of capture searched for the JPEG EOI marker (camera pads the last line)
+
 static uint32_t lightIntensity;
 static uint8_t error;
 
@@ -684,13 +687,21 @@ static const struct regval_list OV5640_QSXGA2XGA[]  =
 	{0xffff, 0xff},	
 };
 
+static const struct regval_list *res_table; // Resolution table written to the camera (NULL: unknown)
+static uint8_t cur_qs;						// JPEG quantization scale written to the camera
+
 // TODO: Implement a state machine instead of multiple flags
-static bool capture_finished;
+static volatile bool capture_finished;
+static volatile uint32_t capture_len;		// Bytes written by the DMA (set at end of capture)
 static bool vsync;
-static bool dma_error;
+static volatile bool dma_error;
 static uint32_t dma_flags;
+static bool dma_locked;						// Radio and I2C locked for the capture (not while streaming)
 
 static uint8_t* dma_buffer;
+#if OV5640_USE_DMA_DBM != TRUE
+static uint32_t dma_size;
+#endif
 
 static uint32_t oldSpeed;
 static uint32_t oldWS;
@@ -751,18 +762,25 @@ uint32_t OV5640_Snapshot2RAM(uint8_t* buffer, uint32_t size, resolution_t res)
 
 	// Capture image until we get a good image (max 10 tries)
 	do {
-		// Clearing buffer
-		uint32_t i;
-		for(i=0; i<size; i++)
-			buffer[i] = 0;
-
 		TRACE_INFO("CAM  > Capture image");
 		status = OV5640_Capture(buffer, size);
 		TRACE_INFO("CAM  > Capture finished");
 
-		size_sampled = size - 1;
-		while(!buffer[size_sampled] && size_sampled > 0)
-			size_sampled--;
+		// The DMA tells the amount of bytes written, the JPEG ends with EOI just before
+		size_sampled = 0;
+		if(status) {
+			uint32_t end = capture_len > size ? size : capture_len;
+			uint32_t stop = end > EOI_SEARCH_RANGE ? end - EOI_SEARCH_RANGE : 0;
+			for(uint32_t i=end; i>stop+1; i--)
+				if(buffer[i-2] == 0xFF && buffer[i-1] == 0xD9) {
+					size_sampled = i;
+					break;
+				}
+			if(!size_sampled) {
+				TRACE_ERROR("CAM  > No JPEG EOI found at end of capture (%d bytes)", capture_len);
+				status = false;
+			}
+		}
 
 		TRACE_INFO("CAM  > Image size: %d bytes", size_sampled);
 	} while(!status && cntr--);
@@ -773,10 +791,22 @@ uint32_t OV5640_Snapshot2RAM(uint8_t* buffer, uint32_t size, resolution_t res)
 const stm32_dma_stream_t *dmastp;
 
 #if OV5640_USE_DMA_DBM == TRUE
-uint16_t dma_index;
+volatile uint16_t dma_index;
 uint16_t dma_buffers;
-#define DMA_SEGMENT_SIZE 1024
-#define DMA_FIFO_BURST_ALIGN 32
+
+/*
+ * Streaming capture. The buffer is used as a ring of dma_buffers segments.
+ * dma_index counts the segments written by the DMA, dma_read is the oldest
+ * segment which is still used by the reader. The capture is aborted if the
+ * DMA is about to overwrite a segment which has not been released yet.
+ */
+static bool dma_ring;
+static volatile bool stream_active;
+static volatile uint16_t dma_read;
+static uint16_t stream_pos;					// Next segment returned by OV5640_StreamRead()
+static uint16_t dma_last;					// Bytes in the last segment (set at end of capture)
+static binary_semaphore_t dma_sem;			// Signaled on every completed segment and at end of capture
+static bool dma_overrun;
 
 
 #if !defined(dmaStreamGetCurrentTarget)
@@ -841,7 +871,7 @@ static void dma_interrupt(void *p, uint32_t flags) {
 		 * Half transfer complete.
 		 * Check if DMA is writing to the last buffer.
 		 */
-		if(dma_index == (dma_buffers - 1)) {
+		if(!dma_ring && dma_index == (dma_buffers - 1)) {
 			/*
 			 * This is the last buffer so we have to terminate DMA.
 			 * The DBM switch is done in h/w.
@@ -873,10 +903,31 @@ static void dma_interrupt(void *p, uint32_t flags) {
 		 */
 
 
+		/*
+		 * The DMA is now writing segment dma_index, the other memory address
+		 * register gets the segment after it.
+		 */
+		uint16_t next = ++dma_index + 1;
+		if(dma_ring) {
+			if(stream_active && (uint16_t)(next - dma_read) >= dma_buffers) {
+				/*
+				 * Reader is too slow, the next segment still holds data.
+				 * Stop DMA and TIM DMA trigger and flag error.
+				 */
+				TIM8->DIER &= ~TIM_DIER_CC1DE;
+				dma_overrun = true;
+				dma_error = true;
+			}
+			next %= dma_buffers;
+			chSysLockFromISR();
+			chBSemSignalI(&dma_sem);
+			chSysUnlockFromISR();
+		}
+
 		if (dmaStreamGetCurrentTarget(dmastp) == 1) {
-			dmaStreamSetMemory0(dmastp, &dma_buffer[++dma_index * DMA_SEGMENT_SIZE]);
+			dmaStreamSetMemory0(dmastp, &dma_buffer[next * DMA_SEGMENT_SIZE]);
 		} else {
-			dmaStreamSetMemory1(dmastp, &dma_buffer[++dma_index * DMA_SEGMENT_SIZE]);
+			dmaStreamSetMemory1(dmastp, &dma_buffer[next * DMA_SEGMENT_SIZE]);
 		}
 		dmaStreamClearInterrupt(dmastp);
 		return;
@@ -948,22 +999,48 @@ CH_IRQ_HANDLER(Vector5C) {
 		 * If buffer was filled in DMA then that is an error.
 		 * We check that here.
 		 */
-		dma_stop();
+		uint16_t remaining = dma_stop();
 		TIM8->DIER &= ~TIM_DIER_CC1DE;
 
+		/*
+		 * The memory address of the current target points to the start of
+		 * the segment which has been written last (DBM) or to the buffer.
+		 * It's used instead of dma_index since the TCIF of a just completed
+		 * segment may not have been handled yet.
+		 */
+#if OV5640_USE_DMA_DBM == TRUE
+		uint8_t *segment = (uint8_t*)(dmaStreamGetCurrentTarget(dmastp) ? dmastp->stream->M1AR : dmastp->stream->M0AR);
+		capture_len = (segment - dma_buffer) + DMA_SEGMENT_SIZE - remaining;
+#else
+		capture_len = dma_size - remaining;
+#endif
+
 		/*
 		 * Disable VSYNC edge interrupts.
 		 * Flag image capture complete.
 		 */
 		nvicDisableVector(EXTI1_IRQn);
 		capture_finished = true;
+
+#if OV5640_USE_DMA_DBM == TRUE
+		dma_last = DMA_SEGMENT_SIZE - remaining;
+		chSysLockFromISR();
+		chBSemSignalI(&dma_sem);
+		chSysUnlockFromISR();
+#else
+		(void)remaining;
+#endif
 	}
 
-	EXTI->PR |= EXTI_PR_PR1;
+	EXTI->PR = EXTI_PR_PR1; // Write 1 to clear (keeps a pending EXTI12)
 	CH_IRQ_EPILOGUE();
 }
 
-bool OV5640_Capture(uint8_t* buffer, uint32_t size)
+/**
+  * Sets up DMA, timer and VSYNC interrupt. The capture starts with the next
+  * frame of the camera.
+  */
+static bool OV5640_CaptureStart(uint8_t* buffer, uint32_t size)
 {
 	OV5640_setLightIntensity();
 
@@ -1031,7 +1108,14 @@ bool OV5640_Capture(uint8_t* buffer, uint32_t size)
     }
     /* Start with buffer index 0. */
     dma_index = 0;
+    dma_read = 0;
+    stream_pos = 0;
+    dma_last = 0;
+    dma_overrun = false;
+    chBSemObjectInit(&dma_sem, true);
 #else
+    dma_buffer = buffer;
+    dma_size = size;
     dmaStreamSetMemory0(dmastp, buffer);
     dmaStreamSetTransactionSize(dmastp, size);
 
@@ -1042,6 +1126,7 @@ bool OV5640_Capture(uint8_t* buffer, uint32_t size)
 
     dma_error = false;
     dma_flags = 0;
+    capture_len = 0;
 
 	/*
 	 * Setup timer for PCLK
@@ -1060,23 +1145,55 @@ bool OV5640_Capture(uint8_t* buffer, uint32_t size)
 	capture_finished = false;
 	vsync = false;
 
-	I2C_Lock(); // Lock I2C because it uses the same DMA
+	// Lock radio and I2C because they use the same DMA (released by
+	// OV5640_CaptureEnd()). A streaming capture locks I2C only while it's set
+	// up and doesn't lock the radio, the SSDV encoder runs until the end of the
+	// frame. A DMA error is detected and the image sampled again.
+#if OV5640_USE_DMA_DBM == TRUE
+	dma_locked = !dma_ring;
+#else
+	dma_locked = true;
+#endif
+	if(dma_locked)
+		lockRadioByCamera();
+	I2C_Lock();
 
 	while(!palReadLine(LINE_CAM_VSYNC)); // Wait for current picture to finish transmission
 
 	// Setup EXTI: EXTI1 PC for PC1 (VSYNC)
 	SYSCFG->EXTICR[0] |= SYSCFG_EXTICR1_EXTI1_PC;
-	EXTI->IMR = EXTI_IMR_MR1; // Activate interrupt for chan1 (=>PC1)
-	EXTI->RTSR = EXTI_RTSR_TR1; // Listen on rising edge
+	// (EXTI12 is the FIFO interrupt of the Si4464 which may be transmitting)
+	chSysLock();
+	EXTI->PR = EXTI_PR_PR1;
+	EXTI->IMR |= EXTI_IMR_MR1; // Activate interrupt for chan1 (=>PC1)
+	EXTI->RTSR |= EXTI_RTSR_TR1; // Listen on rising edge
+	chSysUnlock();
 	nvicEnableVector(EXTI1_IRQn, 1); // Enable interrupt
 
-	// Capture
-	do {
-		chThdSleepMilliseconds(10);
-	} while(!capture_finished && !dma_error);
+	// Streaming capture set up, unlock I2C
+	if(!dma_locked)
+		I2C_Unlock();
+
+	return true;
+}
 
-	// Capture done, unlock I2C
-	I2C_Unlock();
+/**
+  * Finishes the capture after capture_finished or dma_error has been set.
+  */
+static bool OV5640_CaptureEnd(void)
+{
+	// Disable VSYNC interrupt (only EXTI1, see OV5640_CaptureStart())
+	nvicDisableVector(EXTI1_IRQn);
+	chSysLock();
+	EXTI->IMR &= ~EXTI_IMR_MR1;
+	EXTI->RTSR &= ~EXTI_RTSR_TR1;
+	chSysUnlock();
+
+	// Capture done, unlock I2C and radio
+	if(dma_locked) {
+		I2C_Unlock();
+		unlockRadio();
+	}
 
 	if(dma_error)
 	{
@@ -1096,6 +1213,12 @@ bool OV5640_Capture(uint8_t* buffer, uint32_t size)
 			TRACE_ERROR("CAM  > DMA direct mode error");
 			error = 0x5;
 		}
+#if OV5640_USE_DMA_DBM == TRUE
+		if(dma_overrun) {
+			TRACE_ERROR("CAM  > DMA ring overrun (image not read fast enough)");
+			error = 0x6;
+		}
+#endif
 		TRACE_ERROR("CAM  > Error capturing image");
 		return false;
 	}
@@ -1106,6 +1229,97 @@ bool OV5640_Capture(uint8_t* buffer, uint32_t size)
 	return true;
 }
 
+bool OV5640_Capture(uint8_t* buffer, uint32_t size)
+{
+#if OV5640_USE_DMA_DBM == TRUE
+	dma_ring = false;
+#endif
+	if(!OV5640_CaptureStart(buffer, size))
+		return false;
+
+	// Capture
+	do {
+		chThdSleepMilliseconds(10);
+	} while(!capture_finished && !dma_error);
+
+	return OV5640_CaptureEnd();
+}
+
+#if OV5640_USE_DMA_DBM == TRUE
+/**
+  * Starts a streaming capture. The camera writes into buffer as a ring of
+  * DMA_SEGMENT_SIZE segments which have to be read by OV5640_StreamRead()
+  * while the camera is sampling.
+  */
+bool OV5640_StreamStart(uint8_t* buffer, uint32_t size, resolution_t res)
+{
+	OV5640_SetResolution(res == RES_MAX ? RES_UXGA : res);
+
+	dma_ring = true;
+	stream_active = true;
+	TRACE_INFO("CAM  > Stream image");
+	if(!OV5640_CaptureStart(buffer, size)) {
+		stream_active = false;
+		return false;
+	}
+	return true;
+}
+
+/**
+  * Returns the next segment sampled by the camera in data. Blocks until the
+  * DMA has completed it. The segment returned by the previous call is
+  * released. Returns the length of the segment, 0 at the end of the image or
+  * if the capture failed.
+  */
+uint32_t OV5640_StreamRead(const uint8_t** data)
+{
+	if(!stream_active)
+		return 0;
+
+	dma_read = stream_pos; // Release the previous segment
+
+	while(true) {
+		bool finished = capture_finished; // dma_index is final once this is set
+
+		// Complete segment available
+		if(stream_pos != dma_index) {
+			*data = &dma_buffer[(stream_pos++ % dma_buffers) * DMA_SEGMENT_SIZE];
+			return DMA_SEGMENT_SIZE;
+		}
+
+		// Last segment (written partially)
+		if(finished) {
+			stream_active = false;
+			*data = &dma_buffer[(stream_pos % dma_buffers) * DMA_SEGMENT_SIZE];
+			return dma_last;
+		}
+
+		if(dma_error) {
+			stream_active = false;
+			return 0;
+		}
+
+		chBSemWaitTimeout(&dma_sem, MS2ST(10));
+	}
+}
+
+/**
+  * Waits for the end of the frame and finishes the streaming capture.
+  * Segments which have not been read yet are discarded.
+  */
+bool OV5640_StreamStop(void)
+{
+	stream_active = false;
+
+	while(!capture_finished && !dma_error)
+		chThdSleepMilliseconds(1);
+
+	bool status = OV5640_CaptureEnd();
+	dma_ring = false;
+	return status;
+}
+#endif /* OV5640_USE_DMA_DBM == TRUE */
+
 /**
   * Initializes GPIO (for pseudo DCMI)
   */
@@ -1127,23 +1341,58 @@ void OV5640_InitGPIO(void)
 	palSetLineMode(LINE_CAM_RESET, PAL_MODE_OUTPUT_PUSHPULL);
 }
 
+/**
+  * Writes a register table to the camera. Runs of consecutive registers are
+  * merged into one auto increment transfer. Registers which have the same
+  * value in current (table written before, may be NULL) are skipped.
+  */
+static void OV5640_WriteTable(const struct regval_list *table, const struct regval_list *current)
+{
+	uint8_t values[I2C_BURST_MAX];
+	uint16_t start = 0;
+	uint32_t len = 0;
+
+	I2C_BurstStart();
+	for(uint32_t i=0; (table[i].reg != 0xffff) || (table[i].val != 0xff); i++) {
+		if(current) { // Skip unchanged registers
+			uint32_t j;
+			for(j=0; ((current[j].reg != 0xffff) || (current[j].val != 0xff)) && current[j].reg != table[i].reg; j++);
+			if(current[j].reg == table[i].reg && current[j].val == table[i].val)
+				continue;
+		}
+
+		if(len && (table[i].reg != start+len || len == I2C_BURST_MAX)) { // Flush run
+			I2C_writeN_16bitreg(OV5640_I2C_ADR, start, values, len);
+			len = 0;
+		}
+		if(!len)
+			start = table[i].reg;
+		values[len++] = table[i].val;
+	}
+	if(len)
+		I2C_writeN_16bitreg(OV5640_I2C_ADR, start, values, len);
+	I2C_BurstStop();
+}
+
 void OV5640_TransmitConfig(void)
 {
+	res_table = NULL; // Resolution registers are reset
+	cur_qs = OV5640_DEFAULT_QS; // Set by OV5640YUV_Sensor_Dvp_Init
+
 	TRACE_INFO("CAM  > ... Software reset");
 	I2C_write8_16bitreg(OV5640_I2C_ADR, 0x3103, 0x11);
 	I2C_write8_16bitreg(OV5640_I2C_ADR, 0x3008, 0x82);
 	chThdSleepMilliseconds(100);
 
 	TRACE_INFO("CAM  > ... Initialization");
-	for(uint32_t i=0; (OV5640YUV_Sensor_Dvp_Init[i].reg != 0xffff) || (OV5640YUV_Sensor_Dvp_Init[i].val != 0xff); i++)
-		I2C_write8_16bitreg(OV5640_I2C_ADR, OV5640YUV_Sensor_Dvp_Init[i].reg, OV5640YUV_Sensor_Dvp_Init[i].val);
+	OV5640_WriteTable(OV5640YUV_Sensor_Dvp_Init, NULL);
 
 	chThdSleepMilliseconds(500);
 
 	TRACE_INFO("CAM  > ... Configure JPEG");
-	for(uint32_t i=0; (OV5640_JPEG_QSXGA[i].reg != 0xffff) || (OV5640_JPEG_QSXGA[i].val != 0xff); i++)
-		I2C_write8_16bitreg(OV5640_I2C_ADR, OV5640_JPEG_QSXGA[i].reg, OV5640_JPEG_QSXGA[i].val);
+	OV5640_WriteTable(OV5640_JPEG_QSXGA, NULL);
 
+	I2C_BurstStart();
 	TRACE_INFO("CAM  > ... Light Mode: Auto");
 	I2C_write8_16bitreg(OV5640_I2C_ADR, 0x3212, 0x03); // start group 3
 	I2C_write8_16bitreg(OV5640_I2C_ADR, 0x3406, 0x00);
@@ -1187,41 +1436,41 @@ void OV5640_TransmitConfig(void)
 	I2C_write8_16bitreg(OV5640_I2C_ADR, 0x5585, 0x00);
 	I2C_write8_16bitreg(OV5640_I2C_ADR, 0x3212, 0x13); // end group 3
 	I2C_write8_16bitreg(OV5640_I2C_ADR, 0x3212, 0xa3); // launch group 3
+	I2C_BurstStop();
 }
 
 void OV5640_SetResolution(resolution_t res)
 {
-	TRACE_INFO("CAM  > ... Configure Resolution");
+	const struct regval_list *table;
 	switch(res) {
-		case RES_QQVGA:
-			for(uint32_t i=0; (OV5640_QSXGA2QQVGA[i].reg != 0xffff) || (OV5640_QSXGA2QQVGA[i].val != 0xff); i++)
-				I2C_write8_16bitreg(OV5640_I2C_ADR, OV5640_QSXGA2QQVGA[i].reg, OV5640_QSXGA2QQVGA[i].val);
-			break;
-
-		case RES_QVGA:
-			for(uint32_t i=0; (OV5640_QSXGA2QVGA[i].reg != 0xffff) || (OV5640_QSXGA2QVGA[i].val != 0xff); i++)
-				I2C_write8_16bitreg(OV5640_I2C_ADR, OV5640_QSXGA2QVGA[i].reg, OV5640_QSXGA2QVGA[i].val);
-			break;
-
-		case RES_VGA:
-			for(uint32_t i=0; (OV5640_QSXGA2VGA[i].reg != 0xffff) || (OV5640_QSXGA2VGA[i].val != 0xff); i++)
-				I2C_write8_16bitreg(OV5640_I2C_ADR, OV5640_QSXGA2VGA[i].reg, OV5640_QSXGA2VGA[i].val);
-			break;
-
-		case RES_XGA:
-			for(uint32_t i=0; (OV5640_QSXGA2XGA[i].reg != 0xffff) || (OV5640_QSXGA2XGA[i].val != 0xff); i++)
-				I2C_write8_16bitreg(OV5640_I2C_ADR, OV5640_QSXGA2XGA[i].reg, OV5640_QSXGA2XGA[i].val);
-			break;
-
-		case RES_UXGA:
-			for(uint32_t i=0; (OV5640_QSXGA2UXGA[i].reg != 0xffff) || (OV5640_QSXGA2UXGA[i].val != 0xff); i++)
-				I2C_write8_16bitreg(OV5640_I2C_ADR, OV5640_QSXGA2UXGA[i].reg, OV5640_QSXGA2UXGA[i].val);
-			break;
-
-		default: // Default QVGA
-			for(uint32_t i=0; (OV5640_QSXGA2QVGA[i].reg != 0xffff) || (OV5640_QSXGA2QVGA[i].val != 0xff); i++)
-				I2C_write8_16bitreg(OV5640_I2C_ADR, OV5640_QSXGA2QVGA[i].reg, OV5640_QSXGA2QVGA[i].val);
+		case RES_QQVGA:	table = OV5640_QSXGA2QQVGA;	break;
+		case RES_QVGA:	table = OV5640_QSXGA2QVGA;	break;
+		case RES_VGA:	table = OV5640_QSXGA2VGA;	break;
+		case RES_XGA:	table = OV5640_QSXGA2XGA;	break;
+		case RES_UXGA:	table = OV5640_QSXGA2UXGA;	break;
+		default:		table = OV5640_QSXGA2QVGA;	// Default QVGA
 	}
+
+	if(table == res_table) // Already configured
+		return;
+
+	TRACE_INFO("CAM  > ... Configure Resolution");
+	OV5640_WriteTable(table, res_table); // Write registers which differ from the current resolution only
+	res_table = table;
+}
+
+/**
+  * Sets the JPEG quantization scale (register 0x4407). The camera uses the
+  * standard JPEG tables scaled by qs/OV5640_DEFAULT_QS.
+  */
+void OV5640_SetQuantization(uint8_t qs)
+{
+	if(qs == cur_qs) // Already configured
+		return;
+
+	TRACE_INFO("CAM  > ... Quantization scale %d", qs);
+	I2C_write8_16bitreg(OV5640_I2C_ADR, 0x4407, qs & 0x3F);
+	cur_qs = qs;
 }
 
 void OV5640_init(void)
@@ -12,12 +12,21 @@
 #define OV5640_I2C_ADR		0x3C
 
 #define OV5640_USE_DMA_DBM  TRUE
+#define DMA_SEGMENT_SIZE    1024
+#define DMA_FIFO_BURST_ALIGN 32
+#define OV5640_DEFAULT_QS   4     // JPEG quantization scale which gives the standard tables (SSDV quality 4)
 
 uint32_t OV5640_Snapshot2RAM(uint8_t* buffer, uint32_t size, resolution_t resolution);
 bool OV5640_Capture(uint8_t* buffer, uint32_t size);
+#if OV5640_USE_DMA_DBM == TRUE
+bool OV5640_StreamStart(uint8_t* buffer, uint32_t size, resolution_t res);
+uint32_t OV5640_StreamRead(const uint8_t** data);
+bool OV5640_StreamStop(void);
+#endif
 void OV5640_InitGPIO(void);
 void OV5640_TransmitConfig(void);
 void OV5640_SetResolution(resolution_t res);
+void OV5640_SetQuantization(uint8_t qs);
 void OV5640_init(void);
 void OV5640_deinit(void);
 bool OV5640_isAvailable(void);
@@ -21,6 +21,135 @@ static const SPIConfig ls_spicfg = {
 static uint32_t outdiv;
 static bool initialized = false;
 static int16_t lastTemp;
+static binary_semaphore_t fifo_sem;		// Signaled by TX_FIFO_EMPTY on GPIO1
+static uint32_t spi_transactions;		// SPI transactions since startup
+
+typedef struct {
+	uint32_t freq;			// Frequency in Hz
+	uint8_t outdiv;			// Output divider
+	uint8_t band;			// MODEM_CLKGEN_BAND
+	uint8_t pll[4];			// FREQ_CONTROL_INTE and FREQ_CONTROL_FRAC
+	uint8_t dev[3];			// MODEM_FREQ_DEV (AFSK/2GFSK)
+} synth_conf_t;
+
+static synth_conf_t synth_table[SI4464_SYNTH_TABLE_SIZE];	// Precalculated synthesizer settings
+static uint8_t synth_table_len;
+
+/*
+ * Shadow copy of the properties written by this driver. Values above 0xFF
+ * mark properties whose value is unknown (e.g. after a reset of the Si4464).
+ */
+#define PROP_MAX_BATCH		12			/* Max. properties per SET_PROPERTY command */
+#define PROP_UNKNOWN		0xFFFF
+
+static uint16_t prop_global[0x04];
+static uint16_t prop_preamble[0x01];
+static uint16_t prop_sync[0x01];
+static uint16_t prop_pkt[0x0C];
+static uint16_t prop_modem[0x52];
+static uint16_t prop_pa[0x02];
+static uint16_t prop_freq[0x06];
+
+static const struct {
+	uint8_t group;
+	uint8_t size;
+	uint16_t *shadow;
+} prop_groups[] = {
+	{0x00, sizeof(prop_global)/2,	prop_global},
+	{0x10, sizeof(prop_preamble)/2,	prop_preamble},
+	{0x11, sizeof(prop_sync)/2,		prop_sync},
+	{0x12, sizeof(prop_pkt)/2,		prop_pkt},
+	{0x20, sizeof(prop_modem)/2,	prop_modem},
+	{0x22, sizeof(prop_pa)/2,		prop_pa},
+	{0x40, sizeof(prop_freq)/2,		prop_freq}
+};
+
+static uint16_t* getPropShadow(uint8_t group, uint8_t index, uint8_t num) {
+	for(uint8_t i=0; i<sizeof(prop_groups)/sizeof(prop_groups[0]); i++)
+		if(prop_groups[i].group == group)
+			return index+num <= prop_groups[i].size ? &prop_groups[i].shadow[index] : NULL;
+	return NULL;
+}
+
+static void resetPropShadow(void) {
+	for(uint8_t i=0; i<sizeof(prop_groups)/sizeof(prop_groups[0]); i++)
+		for(uint8_t j=0; j<prop_groups[i].size; j++)
+			prop_groups[i].shadow[j] = PROP_UNKNOWN;
+}
+
+/**
+ * Writes num consecutive properties starting at index of a property group.
+ * Properties which already have the requested value are skipped, the others
+ * are sent in as few SET_PROPERTY commands as possible.
+ */
+static void setProperties(uint8_t group, uint8_t index, const uint8_t *values, uint8_t num) {
+	uint16_t *shadow = getPropShadow(group, index, num);
+
+	// Skip unchanged properties at both ends
+	uint8_t first = 0;
+	uint8_t last = num;
+	if(shadow != NULL) {
+		while(first < last && shadow[first] == values[first])
+			first++;
+		while(last > first && shadow[last-1] == values[last-1])
+			last--;
+	}
+
+	while(first < last) {
+		uint8_t n = last-first > PROP_MAX_BATCH ? PROP_MAX_BATCH : last-first;
+		uint8_t cmd[4+PROP_MAX_BATCH] = {0x11, group, n, index+first};
+		memcpy(&cmd[4], &values[first], n);
+		Si4464_write(cmd, 4+n);
+
+		if(shadow != NULL)
+			for(uint8_t i=first; i<first+n; i++)
+				shadow[i] = values[i];
+		first += n;
+	}
+}
+
+static void setProperty(uint8_t group, uint8_t index, uint8_t value) {
+	setProperties(group, index, &value, 1);
+}
+
+/*
+ * GPIO1 (TX_FIFO_EMPTY) is asserted when the free space in the FIFO reaches
+ * the threshold set by Si4464_setFIFOThreshold().
+ */
+CH_IRQ_HANDLER(VectorE0) {
+	CH_IRQ_PROLOGUE();
+
+	if(EXTI->PR & EXTI_PR_PR12) {
+		EXTI->PR = EXTI_PR_PR12;
+
+		chSysLockFromISR();
+		chBSemSignalI(&fifo_sem);
+		chSysUnlockFromISR();
+	}
+
+	CH_IRQ_EPILOGUE();
+}
+
+static void enableFIFOInterrupt(void) {
+	palSetLineMode(LINE_RADIO_GPIO, PAL_MODE_INPUT);
+
+	// Setup EXTI: EXTI12 PC for PC12 (RADIO_GPIO)
+	SYSCFG->EXTICR[3] = (SYSCFG->EXTICR[3] & ~SYSCFG_EXTICR4_EXTI12) | SYSCFG_EXTICR4_EXTI12_PC;
+	chSysLock(); // EXTI1 is set up by the camera driver at the same time
+	EXTI->RTSR |= EXTI_RTSR_TR12; // Listen on rising edge
+	EXTI->PR = EXTI_PR_PR12;
+	EXTI->IMR |= EXTI_IMR_MR12; // Activate interrupt for chan12 (=>PC12)
+	chSysUnlock();
+	nvicEnableVector(EXTI15_10_IRQn, STM32_EXT_EXTI10_15_IRQ_PRIORITY);
+}
+
+static void disableFIFOInterrupt(void) {
+	chSysLock();
+	EXTI->IMR &= ~EXTI_IMR_MR12;
+	EXTI->RTSR &= ~EXTI_RTSR_TR12;
+	chSysUnlock();
+	nvicDisableVector(EXTI15_10_IRQn);
+}
 
 /**
  * Initializes Si4464 transceiver chip. Adjustes the frequency which is shifted by variable
@@ -38,6 +167,7 @@ void Si4464_Init(void) {
 	palSetLine(LINE_RADIO_CS);
 
 	// Reset radio
+	resetPropShadow();
 	palSetLine(LINE_RADIO_SDN);
 	palSetLine(LINE_OSC_EN); // Activate Oscillator
 	chThdSleepMilliseconds(10);
@@ -70,12 +200,11 @@ void Si4464_Init(void) {
 	chThdSleepMilliseconds(25);
 
 	// Set FIFO empty interrupt threshold (32 byte)
-	uint8_t set_fifo_irq[] = {0x11, 0x12, 0x01, 0x0B, 0x20};
-	Si4464_write(set_fifo_irq, 5);
+	Si4464_setFIFOThreshold(0x20);
+	chBSemObjectInit(&fifo_sem, true);
 
 	// Set FIFO to 129 byte
-	uint8_t set_129byte[] = {0x11, 0x00, 0x01, 0x03, 0x10};
-	Si4464_write(set_129byte, 5);
+	setProperty(0x00, 0x03, 0x10);
 
 	// Reset FIFO
 	uint8_t reset_fifo[] = {0x15, 0x01};
@@ -84,25 +213,18 @@ void Si4464_Init(void) {
 	Si4464_write(unreset_fifo, 2);
 
 	// Disable preamble
-	uint8_t disable_preamble[] = {0x11, 0x10, 0x01, 0x00, 0x00};
-	Si4464_write(disable_preamble, 5);
+	setProperty(0x10, 0x00, 0x00);
 
 	// Do not transmit sync word
-	uint8_t no_sync_word[] = {0x11, 0x11, 0x01, 0x00, (0x01 << 7)};
-	Si4464_write(no_sync_word, 5);
+	setProperty(0x11, 0x00, 0x01 << 7);
 
 	// Setup the NCO modulo and oversampling mode
 	uint32_t s = RADIO_CLK / 10;
-	uint8_t f3 = (s >> 24) & 0xFF;
-	uint8_t f2 = (s >> 16) & 0xFF;
-	uint8_t f1 = (s >>  8) & 0xFF;
-	uint8_t f0 = (s >>  0) & 0xFF;
-	uint8_t setup_oversampling[] = {0x11, 0x20, 0x04, 0x06, f3, f2, f1, f0};
-	Si4464_write(setup_oversampling, 8);
+	uint8_t setup_oversampling[] = {(s >> 24) & 0xFF, (s >> 16) & 0xFF, (s >> 8) & 0xFF, s & 0xFF};
+	setProperties(0x20, 0x06, setup_oversampling, sizeof(setup_oversampling));
 
 	// transmit LSB first
-	uint8_t use_lsb_first[] = {0x11, 0x12, 0x01, 0x06, 0x01};
-	Si4464_write(use_lsb_first, 5);
+	setProperty(0x12, 0x06, 0x01);
 
 	// Temperature readout
 	lastTemp = Si4464_getTemperature();
@@ -121,6 +243,7 @@ void Si4464_write(uint8_t* txData, uint32_t len) {
 	spiSelect(&SPID3);
 	spiExchange(&SPID3, len, txData, rxData);
 	spiUnselect(&SPID3);
+	spi_transactions++;
 
 	// Reqest ACK by Si4464
 	rxData[1] = 0x00;
@@ -133,6 +256,7 @@ void Si4464_write(uint8_t* txData, uint32_t len) {
 		spiSelect(&SPID3);
 		spiExchange(&SPID3, 3, rx_ready, rxData);
 		spiUnselect(&SPID3);
+		spi_transactions++;
 	}
 	spiStop(&SPID3);
 	spiReleaseBus(&SPID3);
@@ -151,6 +275,7 @@ void Si4464_read(uint8_t* txData, uint32_t txlen, uint8_t* rxData, uint32_t rxle
 	spiSelect(&SPID3);
 	spiExchange(&SPID3, txlen, txData, null_spi);
 	spiUnselect(&SPID3);
+	spi_transactions++;
 
 	// Reqest ACK by Si4464
 	rxData[1] = 0x00;
@@ -164,125 +289,169 @@ void Si4464_read(uint8_t* txData, uint32_t txlen, uint8_t* rxData, uint32_t rxle
 		spiSelect(&SPID3);
 		spiExchange(&SPID3, rxlen, rx_ready, rxData);
 		spiUnselect(&SPID3);
+		spi_transactions++;
 	}
 	spiStop(&SPID3);
 	spiReleaseBus(&SPID3);
 }
 
-void setFrequency(uint32_t freq, uint16_t shift) {
+/**
+ * Calculates the synthesizer settings for a frequency. This takes a while
+ * since the STM32 has to emulate the float math (FPU is not used).
+ */
+static void calcSynth(uint32_t freq, synth_conf_t *synth) {
 	// Set the output divider according to recommended ranges given in Si4464 datasheet
+	uint32_t div = 0;
 	uint32_t band = 0;
-	if(freq < 705000000UL) {outdiv = 6;  band = 1;};
-	if(freq < 525000000UL) {outdiv = 8;  band = 2;};
-	if(freq < 353000000UL) {outdiv = 12; band = 3;};
-	if(freq < 239000000UL) {outdiv = 16; band = 4;};
-	if(freq < 177000000UL) {outdiv = 24; band = 5;};
+	if(freq < 705000000UL) {div = 6;  band = 1;};
+	if(freq < 525000000UL) {div = 8;  band = 2;};
+	if(freq < 353000000UL) {div = 12; band = 3;};
+	if(freq < 239000000UL) {div = 16; band = 4;};
+	if(freq < 177000000UL) {div = 24; band = 5;};
 
-	// Set the band parameter
 	uint32_t sy_sel = 8;
-	uint8_t set_band_property_command[] = {0x11, 0x20, 0x01, 0x51, (band + sy_sel)};
-	Si4464_write(set_band_property_command, 5);
+	synth->freq = freq;
+	synth->outdiv = div;
+	synth->band = band + sy_sel;
 
-	// Set the PLL parameters
-	uint32_t f_pfd = 2 * RADIO_CLK / outdiv;
+	// PLL parameters
+	uint32_t f_pfd = 2 * RADIO_CLK / div;
 	uint32_t n = ((uint32_t)(freq / f_pfd)) - 1;
 	float ratio = (float)freq / (float)f_pfd;
 	float rest  = ratio - (float)n;
 
 	uint32_t m = (uint32_t)(rest * 524288UL);
-	uint32_t m2 = m >> 16;
-	uint32_t m1 = (m - m2 * 0x10000) >> 8;
-	uint32_t m0 = (m - m2 * 0x10000 - (m1 << 8));
+	synth->pll[0] = n;
+	synth->pll[1] = (m >> 16) & 0xFF;
+	synth->pll[2] = (m >>  8) & 0xFF;
+	synth->pll[3] = (m >>  0) & 0xFF;
+
+	// Deviation used by AFSK and 2GFSK
+	uint32_t x = ((((uint32_t)1 << 19) * div * 1300.0)/(2*RADIO_CLK))*2;
+	synth->dev[0] = (x >> 16) & 0xFF;
+	synth->dev[1] = (x >>  8) & 0xFF;
+	synth->dev[2] = (x >>  0) & 0xFF;
+}
+
+static const synth_conf_t* getSynth(uint32_t freq) {
+	for(uint8_t i=0; i<synth_table_len; i++)
+		if(synth_table[i].freq == freq)
+			return &synth_table[i];
+	return NULL;
+}
+
+/**
+ * Precalculates the synthesizer settings of a frequency, so tuning to it
+ * later on is a simple table lookup. Nothing is done if the frequency is
+ * already known or the table is full.
+ */
+void Si4464_addSynthFrequency(uint32_t freq) {
+	if(!inRadioBand(freq) || getSynth(freq) != NULL || synth_table_len == SI4464_SYNTH_TABLE_SIZE)
+		return;
+
+	synth_conf_t synth;
+	calcSynth(freq, &synth);
+
+	chSysLock();
+	if(getSynth(freq) == NULL && synth_table_len < SI4464_SYNTH_TABLE_SIZE) {
+		synth_table[synth_table_len] = synth;
+		synth_table_len++;
+	}
+	chSysUnlock();
+}
 
+void setFrequency(uint32_t freq, uint16_t shift) {
+	// Lookup synthesizer settings, calculate them if frequency is unknown
+	synth_conf_t calc;
+	const synth_conf_t *synth = getSynth(freq);
+	if(synth == NULL) {
+		calcSynth(freq, &calc);
+		synth = &calc;
+	}
+	outdiv = synth->outdiv;
+
+	// Set the band parameter
+	setProperty(0x20, 0x51, synth->band);
+
+	// Set the PLL parameters
 	uint32_t channel_increment = 524288 * outdiv * shift / (2 * RADIO_CLK);
 	uint8_t c1 = channel_increment / 0x100;
 	uint8_t c0 = channel_increment - (0x100 * c1);
 
-	uint8_t set_frequency_property_command[] = {0x11, 0x40, 0x04, 0x00, n, m2, m1, m0, c1, c0};
-	Si4464_write(set_frequency_property_command, 10);
+	uint8_t set_frequency_property[] = {synth->pll[0], synth->pll[1], synth->pll[2], synth->pll[3], c1, c0};
+	setProperties(0x40, 0x00, set_frequency_property, sizeof(set_frequency_property));
+
+	if(shift) // Deviation is set by setShift()
+		return;
 
-	uint32_t x = ((((uint32_t)1 << 19) * outdiv * 1300.0)/(2*RADIO_CLK))*2;
-	uint8_t x2 = (x >> 16) & 0xFF;
-	uint8_t x1 = (x >>  8) & 0xFF;
-	uint8_t x0 = (x >>  0) & 0xFF;
-	uint8_t set_deviation[] = {0x11, 0x20, 0x03, 0x0a, x2, x1, x0};
-	Si4464_write(set_deviation, 7);
+	setProperties(0x20, 0x0A, synth->dev, sizeof(synth->dev));
 }
 
 void setShift(uint16_t shift) {
 	if(!shift)
 		return;
 
-	float units_per_hz = (( 0x40000 * outdiv ) / (float)RADIO_CLK);
-
-	// Set deviation for 2FSK
-	uint32_t modem_freq_dev = (uint32_t)(units_per_hz * shift / 2.0 );
+	// Set deviation for 2FSK (0x40000 * outdiv / RADIO_CLK units per Hz, half the shift)
+	uint32_t modem_freq_dev = (uint64_t)0x20000 * outdiv * shift / RADIO_CLK;
 	uint8_t modem_freq_dev_0 = 0xFF & modem_freq_dev;
 	uint8_t modem_freq_dev_1 = 0xFF & (modem_freq_dev >> 8);
 	uint8_t modem_freq_dev_2 = 0xFF & (modem_freq_dev >> 16);
 
-	uint8_t set_modem_freq_dev_command[] = {0x11, 0x20, 0x03, 0x0A, modem_freq_dev_2, modem_freq_dev_1, modem_freq_dev_0};
-	Si4464_write(set_modem_freq_dev_command, 7);
+	uint8_t set_modem_freq_dev[] = {modem_freq_dev_2, modem_freq_dev_1, modem_freq_dev_0};
+	setProperties(0x20, 0x0A, set_modem_freq_dev, sizeof(set_modem_freq_dev));
 }
 
 void setModemAFSK(void) {
 	// Setup the NCO data rate for APRS
-	uint8_t setup_data_rate[] = {0x11, 0x20, 0x03, 0x03, 0x00, 0x33, 0x90};
-	Si4464_write(setup_data_rate, 7);
+	uint8_t setup_data_rate[] = {0x00, 0x33, 0x90};
+	setProperties(0x20, 0x03, setup_data_rate, sizeof(setup_data_rate));
 
 	// Use 2GFSK from FIFO (PH)
-	uint8_t use_2gfsk[] = {0x11, 0x20, 0x01, 0x00, 0x03};
-	Si4464_write(use_2gfsk, 5);
-
-	// Set AFSK filter
-	uint8_t coeff[] = {0x81, 0x9f, 0xc4, 0xee, 0x18, 0x3e, 0x5c, 0x70, 0x76};
-	uint8_t i;
-	for(i=0; i<sizeof(coeff); i++) {
-		uint8_t msg[] = {0x11, 0x20, 0x01, 0x17-i, coeff[i]};
-		Si4464_write(msg, 5);
-	}
+	setProperty(0x20, 0x00, 0x03);
+
+	// Set AFSK filter (MODEM_TX_FILTER_COEFF_8 at 0x0F to COEFF_0 at 0x17)
+	uint8_t coeff[] = {0x76, 0x70, 0x5c, 0x3e, 0x18, 0xee, 0xc4, 0x9f, 0x81};
+	setProperties(0x20, 0x0F, coeff, sizeof(coeff));
 }
 
 void setModemOOK(ook_conf_t* conf) {
 	// Setup the NCO data rate for 2FSK
 	uint16_t speed = conf->speed * 5 / 6;
-	uint8_t setup_data_rate[] = {0x11, 0x20, 0x03, 0x03, 0x00, 0x00, (uint8_t)speed};
-	Si4464_write(setup_data_rate, 7);
+	uint8_t setup_data_rate[] = {0x00, 0x00, (uint8_t)speed};
+	setProperties(0x20, 0x03, setup_data_rate, sizeof(setup_data_rate));
 
 	// Use 2FSK from FIFO (PH)
-	uint8_t use_ook[] = {0x11, 0x20, 0x01, 0x00, 0x01};
-	Si4464_write(use_ook, 5);
+	setProperty(0x20, 0x00, 0x01);
 }
 
 void setModem2FSK(fsk_conf_t* conf) {
 	// Setup the NCO data rate for 2FSK
-	uint8_t setup_data_rate[] = {0x11, 0x20, 0x03, 0x03, (uint8_t)(conf->baud >> 16), (uint8_t)(conf->baud >> 8), (uint8_t)conf->baud};
-	Si4464_write(setup_data_rate, 7);
+	uint8_t setup_data_rate[] = {(uint8_t)(conf->baud >> 16), (uint8_t)(conf->baud >> 8), (uint8_t)conf->baud};
+	setProperties(0x20, 0x03, setup_data_rate, sizeof(setup_data_rate));
 
 	// Use 2FSK from FIFO (PH)
-	uint8_t use_2fsk[] = {0x11, 0x20, 0x01, 0x00, 0x02};
-	Si4464_write(use_2fsk, 5);
+	setProperty(0x20, 0x00, 0x02);
 }
 
 void setModem2GFSK(gfsk_conf_t* conf) {
 	// Setup the NCO data rate for 2GFSK
-	uint8_t setup_data_rate[] = {0x11, 0x20, 0x03, 0x03, (uint8_t)(conf->speed >> 16), (uint8_t)(conf->speed >> 8), (uint8_t)conf->speed};
-	Si4464_write(setup_data_rate, 7);
+	uint8_t setup_data_rate[] = {(uint8_t)(conf->speed >> 16), (uint8_t)(conf->speed >> 8), (uint8_t)conf->speed};
+	setProperties(0x20, 0x03, setup_data_rate, sizeof(setup_data_rate));
 
 	// Use 2GFSK from FIFO (PH)
-	uint8_t use_2gfsk[] = {0x11, 0x20, 0x01, 0x00, 0x02};
-	Si4464_write(use_2gfsk, 5);
+	setProperty(0x20, 0x00, 0x02);
 }
 
 void setPowerLevel(int8_t level) {
 	// Set the Power
-	uint8_t set_pa_pwr_lvl_property_command[] = {0x11, 0x22, 0x01, 0x01, level};
-	Si4464_write(set_pa_pwr_lvl_property_command, 5);
+	setProperty(0x22, 0x01, level);
 }
 
 void startTx(uint16_t size) {
 	palClearLine(LINE_IO_LED1);	// Set indication LED
 
+	enableFIFOInterrupt();
+
 	uint8_t change_state_command[] = {0x31, 0x00, 0x30, (size >> 8) & 0x1F, size & 0xFF};
 	Si4464_write(change_state_command, 5);
 }
@@ -295,6 +464,8 @@ void stopTx(void) {
 }
 
 void Si4464_shutdown(void) {
+	disableFIFOInterrupt();
+
 	palSetLineMode(LINE_SPI_SCK, PAL_MODE_INPUT_PULLDOWN);		// SCK
 	palSetLineMode(LINE_SPI_MISO, PAL_MODE_INPUT_PULLDOWN);		// MISO
 	palSetLineMode(LINE_SPI_MOSI, PAL_MODE_INPUT_PULLDOWN);		// MOSI
@@ -347,6 +518,25 @@ uint8_t Si4464_freeFIFO(void) {
 	return rxData[3];
 }
 
+/**
+  * Sets the amount of free bytes in the FIFO at which TX_FIFO_EMPTY is
+  * asserted on GPIO1.
+  */
+void Si4464_setFIFOThreshold(uint8_t thres) {
+	setProperty(0x12, 0x0B, thres);
+}
+
+/**
+  * Waits until the FIFO has at least as many free bytes as set by
+  * Si4464_setFIFOThreshold(). Returns false if the timeout elapsed first.
+  */
+bool Si4464_waitFIFO(systime_t timeout) {
+	chBSemReset(&fifo_sem, true);
+	if(RADIO_READ_GPIO()) // Already below threshold
+		return true;
+	return chBSemWaitTimeout(&fifo_sem, timeout) == MSG_OK;
+}
+
 /**
   * Returns internal state of Si4464
   */
@@ -368,3 +558,11 @@ int16_t Si4464_getTemperature(void) {
 int16_t Si4464_getLastTemperature(void) {
 	return lastTemp;
 }
+
+/**
+  * Returns the amount of SPI transactions (commands and CTS polls) since
+  * startup.
+  */
+uint32_t Si4464_getSPICount(void) {
+	return spi_transactions;
+}
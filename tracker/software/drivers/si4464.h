@@ -22,8 +22,13 @@
 #define SI4464_STATE_TX			7
 #define SI4464_STATE_RX			8
 
+#define SI4464_FIFO_SIZE		129		/* Shared TX/RX FIFO */
+#define SI4464_MAX_TX_LEN		0x1FFF	/* Max. bytes per transmission (13 bit TX_LEN of START_TX) */
+#define SI4464_SYNTH_TABLE_SIZE	16		/* Max. frequencies with precalculated synthesizer settings */
+
 void Si4464_Init(void);
 void Si4464_write(uint8_t* txData, uint32_t len);
+void Si4464_addSynthFrequency(uint32_t freq);
 void setFrequency(uint32_t freq, uint16_t shift);
 void setShift(uint16_t shift);
 void setModemAFSK(void);
@@ -38,9 +43,12 @@ void Si4464_shutdown(void);
 bool radioTune(uint32_t frequency, uint16_t shift, int8_t level, uint16_t size);
 void Si4464_writeFIFO(uint8_t *msg, uint8_t size);
 uint8_t Si4464_freeFIFO(void);
+void Si4464_setFIFOThreshold(uint8_t thres);
+bool Si4464_waitFIFO(systime_t timeout);
 uint8_t Si4464_getState(void);
 int16_t Si4464_getTemperature(void);
 int16_t Si4464_getLastTemperature(void);
+uint32_t Si4464_getSPICount(void);
 
 #endif
 
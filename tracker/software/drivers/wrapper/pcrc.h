@@ -0,0 +1,18 @@
+#ifndef __PCRC_H__
+#define __PCRC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+  * PCRC_USE_HW selects the CRC unit of the STM32. Host and simulator builds
+  * define it to 0 and get the table driven implementation.
+  */
+#ifndef PCRC_USE_HW
+#define PCRC_USE_HW		1
+#endif
+
+uint32_t crc32(const void *data, size_t length);
+
+#endif
+
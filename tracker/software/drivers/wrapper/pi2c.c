@@ -5,10 +5,12 @@
 #include "ch.h"
 #include "hal.h"
 #include "pi2c.h"
+#include <string.h>
 
 #define I2C_DRIVER	(&I2CD1)
 
 static uint8_t error;
+static thread_t *burst_owner; // Thread holding the bus between I2C_BurstStart() and I2C_BurstStop()
 
 const I2CConfig _i2cfg = {
 	OPMODE_I2C,
@@ -17,11 +19,19 @@ const I2CConfig _i2cfg = {
 };
 
 static bool I2C_transmit(uint8_t addr, uint8_t *txbuf, uint32_t txbytes, uint8_t *rxbuf, uint32_t rxbytes, systime_t timeout) {
-	i2cAcquireBus(I2C_DRIVER);
-	i2cStart(I2C_DRIVER, &_i2cfg);
+	bool burst = burst_owner == chThdGetSelfX(); // Bus already opened by I2C_BurstStart()
+	if(!burst) {
+		i2cAcquireBus(I2C_DRIVER);
+		i2cStart(I2C_DRIVER, &_i2cfg);
+	}
 	msg_t i2c_status = i2cMasterTransmitTimeout(I2C_DRIVER, addr, txbuf, txbytes, rxbuf, rxbytes, timeout);
-	i2cStop(I2C_DRIVER);
-	i2cReleaseBus(I2C_DRIVER);
+	if(!burst) {
+		i2cStop(I2C_DRIVER);
+		i2cReleaseBus(I2C_DRIVER);
+	} else if(i2c_status != MSG_OK) { // Restart driver within burst
+		i2cStop(I2C_DRIVER);
+		i2cStart(I2C_DRIVER, &_i2cfg);
+	}
 
 	if(i2c_status == MSG_TIMEOUT) { // Restart I2C at timeout
 		TRACE_ERROR("I2C  > TIMEOUT (ADDR 0x%02x)", addr);
@@ -36,6 +46,25 @@ static bool I2C_transmit(uint8_t addr, uint8_t *txbuf, uint32_t txbytes, uint8_t
 	return i2c_status == MSG_OK;
 }
 
+/**
+  * Keeps the bus acquired and the driver started for all following transfers
+  * of the calling thread until I2C_BurstStop() is called. Saves the driver
+  * start/stop of each transfer when writing a lot of registers.
+  */
+void I2C_BurstStart(void)
+{
+	i2cAcquireBus(I2C_DRIVER);
+	i2cStart(I2C_DRIVER, &_i2cfg);
+	burst_owner = chThdGetSelfX();
+}
+
+void I2C_BurstStop(void)
+{
+	burst_owner = NULL;
+	i2cStop(I2C_DRIVER);
+	i2cReleaseBus(I2C_DRIVER);
+}
+
 void I2C_Lock(void)
 {
 	i2cAcquireBus(I2C_DRIVER);
@@ -103,6 +132,17 @@ bool I2C_write8_16bitreg(uint8_t address, uint16_t reg, uint8_t value) // 16bit
 	return I2C_transmit(address, txbuf, 3, NULL, 0, MS2ST(100));
 }
 
+bool I2C_writeN_16bitreg(uint8_t address, uint16_t reg, const uint8_t *values, uint32_t length) // 16bit register, auto increment (for OV5640)
+{
+	uint8_t txbuf[2+I2C_BURST_MAX];
+	if(length > I2C_BURST_MAX)
+		return false;
+	txbuf[0] = reg >> 8;
+	txbuf[1] = reg & 0xFF;
+	memcpy(&txbuf[2], values, length);
+	return I2C_transmit(address, txbuf, 2+length, NULL, 0, MS2ST(100));
+}
+
 uint8_t I2C_hasError(void)
 {
 	return error;
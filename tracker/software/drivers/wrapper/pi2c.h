@@ -11,6 +11,8 @@
 #include "debug.h"
 #include "config.h"
 
+#define I2C_BURST_MAX	32	// Maximum amount of registers written by one I2C_writeN_16bitreg()
+
 void pi2cInit(void);
 
 bool I2C_write8(uint8_t address, uint8_t reg, uint8_t value);
@@ -19,12 +21,15 @@ bool I2C_read8(uint8_t address, uint8_t reg, uint8_t *val);
 bool I2C_read16(uint8_t address, uint8_t reg, uint16_t *val);
 
 bool I2C_write8_16bitreg(uint8_t address, uint16_t reg, uint8_t value); // 16bit register (for OV5640)
+bool I2C_writeN_16bitreg(uint8_t address, uint16_t reg, const uint8_t *values, uint32_t length); // 16bit register, auto increment (for OV5640)
 bool I2C_read8_16bitreg(uint8_t address, uint16_t reg, uint8_t *val); // 16bit register (for OV5640)
 
 bool I2C_read16_LE(uint8_t address, uint8_t reg, uint16_t *val);
 
 void I2C_Lock(void);
 void I2C_Unlock(void);
+void I2C_BurstStart(void);
+void I2C_BurstStop(void);
 
 uint8_t I2C_hasError(void);
 
@@ -42,7 +42,7 @@ void aprs_encode_position(ax25_t* packet, const aprs_conf_t *config, trackPoint_
 	char temp[128];
 
 	// Encode header
-	ax25_send_header(packet, config->callsign, config->ssid, config->path, packet->size > 0 ? 0 : config->preamble);
+	ax25_send_header(packet, config->callsign, config->ssid, config->path, packet->size > 0 ? 0 : config->preamble, config->fx25);
 	ax25_send_byte(packet, '!');
 
 	// Latitude
@@ -133,6 +133,8 @@ void aprs_encode_init(ax25_t* packet, uint8_t* buffer, uint16_t size, mod_t mod)
 {
 	packet->data = buffer;
 	packet->max_size = size;
+	// Transmission not longer than the buffer and than one Si4464 transmission in bits
+	packet->max_bits = size * 8 < RADIO_MAX_TX_BITS(mod) ? size * 8 : RADIO_MAX_TX_BITS(mod);
 	packet->mod = mod;
 
 	// Encode APRS header
@@ -141,7 +143,7 @@ void aprs_encode_init(ax25_t* packet, uint8_t* buffer, uint16_t size, mod_t mod)
 void aprs_encode_data_packet(ax25_t* packet, char packetType, const aprs_conf_t *config, uint8_t *data, size_t size)
 {
 	// Encode header
-	ax25_send_header(packet, config->callsign, config->ssid, config->path, packet->size > 0 ? 0 : config->preamble);
+	ax25_send_header(packet, config->callsign, config->ssid, config->path, packet->size > 0 ? 0 : config->preamble, config->fx25);
 	ax25_send_string(packet, "{{");
 	ax25_send_byte(packet, packetType);
 
@@ -152,10 +154,13 @@ void aprs_encode_data_packet(ax25_t* packet, char packetType, const aprs_conf_t
 	// Encode footer
 	ax25_send_footer(packet);
 }
+/**
+ * Returns the size of the packet in bits (as transmitted). The packet is
+ * HDLC encoded, scrambled and NRZI encoded while it is transmitted (see
+ * ax25_stream_get()), use ax25_encode_buffer() to get the encoded bits.
+ */
 uint32_t aprs_encode_finalize(ax25_t* packet)
 {
-	scramble(packet);
-	nrzi_encode(packet);
 	return packet->size;
 }
 
@@ -167,7 +172,7 @@ void aprs_encode_message(ax25_t* packet, const aprs_conf_t *config, const char *
 	char temp[10];
 
 	// Encode header
-	ax25_send_header(packet, config->callsign, config->ssid, config->path, packet->size > 0 ? 0 : config->preamble);
+	ax25_send_header(packet, config->callsign, config->ssid, config->path, packet->size > 0 ? 0 : config->preamble, config->fx25);
 	ax25_send_byte(packet, ':');
 
 	chsnprintf(temp, sizeof(temp), "%-9s", receiver);
@@ -192,7 +197,7 @@ void aprs_encode_telemetry_configuration(ax25_t* packet, const aprs_conf_t *conf
 	char temp[4];
 
 	// Encode header
-	ax25_send_header(packet, config->callsign, config->ssid, config->path, packet->size > 0 ? 0 : config->preamble);
+	ax25_send_header(packet, config->callsign, config->ssid, config->path, packet->size > 0 ? 0 : config->preamble, config->fx25);
 	ax25_send_byte(packet, ':'); // Message flag
 
 	// Callsign
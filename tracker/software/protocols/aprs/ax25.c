@@ -20,89 +20,163 @@
 #include "config.h"
 #include "debug.h"
 #include "aprs.h"
+#include "rs8.h"
+#include <string.h>
+
+#define AX25_FRAME_HEAD		5			/* Frame record header: preamble flags (16bit), frame length (16bit), FX.25 tag (8bit) */
+#define AX25_FRAME_END		0xFFFF		/* Preamble value marking the end of the frame records */
+#define AX25_SYNC_FLAGS		4			/* Flags between preamble and frame */
+#define FX25_TAG_LEN		8			/* Correlation tag size in bytes */
+#define FX25_MAX_DATA		239			/* Largest FX.25 data block in bytes */
+
+/*
+ * The packet is stored as a list of frame records: the amount of preamble
+ * flags, the frame length, the FX.25 tag and the frame bytes (FCS included).
+ * Flags, bit stuffing, scrambling and NRZI are applied by ax25_stream_get()
+ * while the packet is transmitted. FX.25 frames are stored as they are sent
+ * (correlation tag, HDLC encoded frame and check bytes).
+ */
 
-#define AX25_WRITE_BIT(data, size) { \
-	data[size >> 3] |= (1 << (size & 7)); \
-}
-#define AX25_CLEAR_BIT(data, size) { \
-	data[size >> 3] &= ~(1 << (size & 7)); \
-}
-
-static void update_crc(ax25_t *packet, char bit)
+/* FX.25 codes, the tag number is the index + 1 */
+typedef struct {
+	uint64_t tag;		// Correlation tag (sent LSB first)
+	uint8_t n;			// Block size (data and check bytes)
+	uint8_t k;			// Data bytes
+} fx25_code_t;
+
+static const fx25_code_t FX25_CODES[] = {
+	{0xB74DB7DF8A532F3E, 255, 239},
+	{0x26FF60A600CC8FDE, 144, 128},
+	{0xC7DC0508F3D9B09E,  80,  64},
+	{0x8F056EB4369660EE,  48,  32},
+	{0x6E260B1AC5835FAE, 255, 223},
+	{0xFF94DC634F1CFF4E, 160, 128},
+	{0x1EB7B9CDBC09C00E,  96,  64},
+	{0xDBF869BD2DBB1776,  64,  32},
+	{0x3ADB0C13DEAE2836, 255, 191},
+	{0xAB69DB6A543188D6, 192, 128},
+	{0x4A4ABEC4A724B796, 128,  64},
+};
+
+/* CRC-16/X.25 (reflected poly 0x8408) of each byte value */
+static const uint16_t CRC_TABLE[] = {
+	0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+	0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+	0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+	0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+	0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+	0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+	0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+	0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+	0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+	0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+	0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+	0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+	0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+	0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+	0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+	0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+	0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+	0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+	0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+	0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+	0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+	0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+	0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+	0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+	0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+	0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+	0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+	0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+	0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+	0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+	0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+	0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78,
+};
+
+/*
+ * Runs of ones of each byte value (LSB first): Lower nibble is the amount of
+ * ones at the start of the byte, upper nibble the amount at its end. 0xFF
+ * marks bytes which contain five or more ones in a row.
+ */
+static const uint8_t ONES_RUNS[] = {
+	0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x04,
+	0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0xFF,
+	0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x04,
+	0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0xFF, 0xFF,
+	0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x04,
+	0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0xFF,
+	0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x04,
+	0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x03, 0x00, 0x01, 0x00, 0x02, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x10, 0x11, 0x10, 0x12, 0x10, 0x11, 0x10, 0x13, 0x10, 0x11, 0x10, 0x12, 0x10, 0x11, 0x10, 0x14,
+	0x10, 0x11, 0x10, 0x12, 0x10, 0x11, 0x10, 0x13, 0x10, 0x11, 0x10, 0x12, 0x10, 0x11, 0x10, 0xFF,
+	0x10, 0x11, 0x10, 0x12, 0x10, 0x11, 0x10, 0x13, 0x10, 0x11, 0x10, 0x12, 0x10, 0x11, 0x10, 0x14,
+	0x10, 0x11, 0x10, 0x12, 0x10, 0x11, 0x10, 0x13, 0x10, 0x11, 0x10, 0x12, 0x10, 0x11, 0xFF, 0xFF,
+	0x20, 0x21, 0x20, 0x22, 0x20, 0x21, 0x20, 0x23, 0x20, 0x21, 0x20, 0x22, 0x20, 0x21, 0x20, 0x24,
+	0x20, 0x21, 0x20, 0x22, 0x20, 0x21, 0x20, 0x23, 0x20, 0x21, 0x20, 0x22, 0x20, 0x21, 0x20, 0xFF,
+	0x30, 0x31, 0x30, 0x32, 0x30, 0x31, 0x30, 0x33, 0x30, 0x31, 0x30, 0x32, 0x30, 0x31, 0x30, 0x34,
+	0x40, 0x41, 0x40, 0x42, 0x40, 0x41, 0x40, 0x43, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static void update_crc(ax25_t *packet, uint8_t byte)
 {
-	packet->crc ^= bit;
-	if(packet->crc & 1)
-		packet->crc = (packet->crc >> 1) ^ 0x8408;  // X-modem CRC poly
-	else
-		packet->crc = packet->crc >> 1;
+	packet->crc = (packet->crc >> 8) ^ CRC_TABLE[(packet->crc ^ byte) & 0xFF];
 }
 
-uint32_t lfsr;
-uint8_t scramble_bit(uint8_t _in) {
-	uint8_t x = (_in ^ (lfsr >> 16) ^ (lfsr >> 11)) & 1;
-	lfsr = (lfsr << 1) | (x & 1);
-	return x;
-}
-
-static void send_byte(ax25_t *packet, char byte)
+/**
+ * Bit stuffs one byte, ones is the amount of ones in a row before it. Returns
+ * the amount of bits (8-10) written into bits (LSB first).
+ */
+static uint8_t stuff_byte(uint8_t byte, uint8_t *ones, uint16_t *bits)
 {
-	int i;
-	for(i=0; i<8; i++) {
-		update_crc(packet, (byte >> i) & 1);
-		if((byte >> i) & 1) {
-			// Next bit is a '1'
-			if(packet->size >= packet->max_size * 8)  // Prevent buffer overrun
-				return;
-
-			AX25_WRITE_BIT(packet->data, packet->size);
+	uint8_t runs = ONES_RUNS[byte];
+	if(runs != 0xFF && *ones + (runs & 0xF) < 5) { // No zero padding needed
+		*ones = runs >> 4;
+		*bits = byte;
+		return 8;
+	}
 
-			packet->size++;
-			packet->ones_in_a_row++;
-			if(packet->ones_in_a_row < 5)
+	uint8_t cnt = 0;
+	*bits = 0;
+	for(uint8_t i=0; i<8; i++) {
+		if((byte >> i) & 1) {
+			*bits |= 1 << cnt++;
+			(*ones)++;
+			if(*ones < 5)
 				continue;
 		}
-		// Next bit is a '0' or a zero padding after 5 ones in a row
-		if(packet->size >= packet->max_size * 8)    // Prevent buffer overrun
-			return;
-
-		AX25_CLEAR_BIT(packet->data, packet->size);
-
-		packet->size++;
-		packet->ones_in_a_row = 0;
+		cnt++; // Next bit is a '0' or a zero padding after 5 ones in a row
+		*ones = 0;
 	}
+	return cnt;
 }
 
-void ax25_send_byte(ax25_t *packet, char byte)
+static void write_word(uint8_t *data, uint16_t word)
 {
-	send_byte(packet, byte);
+	data[0] = word & 0xFF;
+	data[1] = word >> 8;
 }
 
-void ax25_send_sync(ax25_t *packet)
+static uint16_t read_word(const uint8_t *data)
 {
-	unsigned char byte = 0x00;
-	int i;
-	for(i=0; i<8; i++, packet->size++) {
-		if(packet->size >= packet->max_size * 8)  // Prevent buffer overrun
-			return;
-		if((byte >> i) & 1)
-			packet->data[packet->size >> 3] |= (1 << (packet->size & 7));
-		else
-			packet->data[packet->size >> 3] &= ~(1 << (packet->size & 7));
-	}
+	return data[0] | (data[1] << 8);
+}
+
+static void send_byte(ax25_t *packet, char byte)
+{
+	if(packet->len + 2 >= packet->max_size)  // Prevent buffer overrun (keep space for end mark)
+		return;
+	packet->data[packet->len++] = byte;
+
+	// Update CRC and count bits after stuffing
+	uint16_t bits;
+	update_crc(packet, byte);
+	packet->size += stuff_byte(byte, &packet->ones_in_a_row, &bits);
 }
 
-void ax25_send_flag(ax25_t *packet)
+void ax25_send_byte(ax25_t *packet, char byte)
 {
-  unsigned char byte = 0x7e;
-  int i;
-  for(i=0; i<8; i++, packet->size++) {
-    if(packet->size >= packet->max_size * 8)  // Prevent buffer overrun
-      return;
-    if((byte >> i) & 1)
-      packet->data[packet->size >> 3] |= (1 << (packet->size & 7));
-    else
-      packet->data[packet->size >> 3] &= ~(1 << (packet->size & 7));
-  }
+	send_byte(packet, byte);
 }
 
 void ax25_send_string(ax25_t *packet, const char *string)
@@ -116,14 +190,22 @@ void ax25_send_string(ax25_t *packet, const char *string)
 void ax25_init(ax25_t *packet)
 {
 	packet->size = 0;
+	packet->len = 0;
+	packet->preamble = 0;
+	write_word(packet->data, AX25_FRAME_END);
 }
 
-void ax25_send_header(ax25_t *packet, const char *callsign, uint8_t ssid, const char *path, uint16_t preamble)
+/**
+ * Starts a new frame. fx25 is the amount of FX.25 check bytes (16, 32 or 64)
+ * or 0 for plain AX.25.
+ */
+void ax25_send_header(ax25_t *packet, const char *callsign, uint8_t ssid, const char *path, uint16_t preamble, uint8_t fx25)
 {
 	uint16_t i, j;
 	uint8_t tmp[8];
 	packet->ones_in_a_row = 0;
 	packet->crc = 0xffff;
+	packet->fx25 = fx25;
 
 	// Send preamble ("a bunch of 0s")
 	if(packet->mod == MOD_2GFSK) {
@@ -131,22 +213,28 @@ void ax25_send_header(ax25_t *packet, const char *callsign, uint8_t ssid, const
 	} else {
 		preamble = preamble * 3 / 20;
 	}
-	for(i=0; i<preamble; i++)
-	{
-		ax25_send_flag(packet);
+	if(packet->len + AX25_FRAME_HEAD + 2 > packet->max_size // Prevent buffer overrun
+	|| packet->size + (preamble + AX25_SYNC_FLAGS) * 8 + AX25_MAX_FRAME_BITS > packet->max_bits) { // Prevent exceeding the bit budget
+		packet->len = packet->max_size; // Drop this frame
+		packet->frame = packet->max_size;
+		return;
 	}
 
-	// Send flag
-	for(uint8_t i=0; i<4; i++)
-	{
-		ax25_send_flag(packet);
-	}
+	// Open frame record, preamble and flags are sent by the stream
+	packet->frame = packet->len;
+	write_word(&packet->data[packet->len], preamble);
+	write_word(&packet->data[packet->len+2], 0);
+	packet->data[packet->len+4] = 0;
+	packet->len += AX25_FRAME_HEAD;
+	packet->size += (preamble + AX25_SYNC_FLAGS) * 8;
+	if(preamble)
+		packet->preamble = preamble * 8;
 
 	ax25_send_path(packet, APRS_DEST_CALLSIGN, APRS_DEST_SSID, false);		// Destination callsign
-	ax25_send_path(packet, callsign, ssid, path[0] == 0 || path == NULL);	// Source callsign
+	ax25_send_path(packet, callsign, ssid, path == NULL || path[0] == 0);	// Source callsign
 
 	// Parse path
-	for(i=0, j=0; (path[i-1] != 0 || i == 0) && path != NULL; i++) {
+	for(i=0, j=0; path != NULL && (i == 0 || path[i-1] != 0); i++) {
 		if(path[i] == ',' || path[i] == 0) { // Found block in path
 			if(!j) // Block empty
 				break;
@@ -195,6 +283,79 @@ void ax25_send_path(ax25_t *packet, const char *callsign, uint8_t ssid, bool las
 	send_byte(packet, ('0' + ssid) << 1 | (last & 0x1));
 }
 
+/**
+ * Replaces the frame of the current record by an FX.25 block: The correlation
+ * tag, the HDLC encoded frame (padded with flags) and the Reed-Solomon check
+ * bytes. The shortest code with packet->fx25 check bytes is used. Legacy
+ * receivers decode the frame inside the block as usual. The frame is kept
+ * as AX.25 if it doesn't fit into any code or into the buffer.
+ */
+static void fx25_encode(ax25_t *packet)
+{
+	uint8_t *frame = &packet->data[packet->frame + AX25_FRAME_HEAD];
+	uint16_t len = packet->len - packet->frame - AX25_FRAME_HEAD;
+	uint8_t block[FX25_MAX_DATA];
+	uint16_t bytes = 0;
+	uint16_t stuffed = 0;
+	uint8_t ones = 0;
+
+	// HDLC encode frame behind the start of frame flag
+	uint32_t acc = 0x7E;
+	uint8_t acc_cnt = 8;
+	for(uint16_t i=0; i<len; i++) {
+		uint16_t bits;
+		uint8_t cnt = stuff_byte(frame[i], &ones, &bits);
+		acc |= (uint32_t)bits << acc_cnt;
+		acc_cnt += cnt;
+		stuffed += cnt;
+		for(; acc_cnt >= 8; acc_cnt -= 8, acc >>= 8) {
+			if(bytes == FX25_MAX_DATA)
+				return; // Too long for FX.25
+			block[bytes++] = acc;
+		}
+	}
+
+	// Find the shortest code for frame and end of frame flag
+	uint16_t needed = bytes + (acc_cnt + 8 + 7) / 8;
+	uint8_t tag = 0;
+	for(uint8_t i=0; i<sizeof(FX25_CODES)/sizeof(FX25_CODES[0]); i++) {
+		const fx25_code_t *code = &FX25_CODES[i];
+		if(code->n - code->k == packet->fx25 && code->k >= needed && (!tag || code->k < FX25_CODES[tag-1].k))
+			tag = i+1;
+	}
+	if(!tag)
+		return; // No code for this frame
+	const fx25_code_t *code = &FX25_CODES[tag-1];
+	if(packet->frame + AX25_FRAME_HEAD + FX25_TAG_LEN + code->n + 2 > packet->max_size)
+		return; // Prevent buffer overrun
+
+	// End of frame flag, pad data block with flags
+	acc |= 0x7E << acc_cnt;
+	acc_cnt += 8;
+	while(bytes < code->k) {
+		if(acc_cnt < 8) {
+			acc |= 0x7E << acc_cnt;
+			acc_cnt += 8;
+		}
+		block[bytes++] = acc;
+		acc >>= 8;
+		acc_cnt -= 8;
+	}
+
+	// Reed-Solomon check bytes, the code is shortened by zeros behind the data
+	const rs8_code_t *rs = code->n - code->k == 64 ? &RS8_FX25_64 : code->n - code->k == 32 ? &RS8_FX25_32 : &RS8_FX25_16;
+	memset(&block[bytes], 0, 255 - rs->nroots - bytes);
+	for(uint8_t i=0; i<FX25_TAG_LEN; i++)
+		frame[i] = code->tag >> (i * 8);
+	memcpy(&frame[FX25_TAG_LEN], block, code->k);
+	encode_rs_8_code(rs, block, &frame[FX25_TAG_LEN + code->k], 0);
+
+	// Replace frame by FX.25 block (the end of frame flag is part of the block)
+	packet->data[packet->frame+4] = tag;
+	packet->len = packet->frame + AX25_FRAME_HEAD + FX25_TAG_LEN + code->n;
+	packet->size += (FX25_TAG_LEN + code->n) * 8 - stuffed - 8;
+}
+
 void ax25_send_footer(ax25_t *packet)
 {
 	// Save the crc so that it can be treated it atomically
@@ -207,42 +368,136 @@ void ax25_send_footer(ax25_t *packet)
 
 	packet->crc = final_crc;
 
-	// Signal the end of frame
-	ax25_send_flag(packet);
+	// Close frame record, the end of frame flag is sent by the stream
+	if(packet->frame >= packet->max_size) // Frame has been dropped
+		return;
+	packet->size += 8;
+	if(packet->fx25)
+		fx25_encode(packet);
+	write_word(&packet->data[packet->frame+2], packet->len - packet->frame - AX25_FRAME_HEAD);
+	write_word(&packet->data[packet->len], AX25_FRAME_END);
 }
 
 /**
-  * Scrambling for 2GFSK
+  * Initializes the stream. Scrambling is used for 2GFSK only.
   */
-void scramble(ax25_t *packet) {
-	if(packet->mod != MOD_2GFSK)
-		return; // Scrambling not necessary
-
-	// Scramble
-	lfsr = 0;
-	for(uint32_t i=0; i<packet->size; i++) {
-		uint8_t bit = scramble_bit((packet->data[i >> 3] >> (i & 0x7)) & 0x1);
-		if(bit) {
-			AX25_WRITE_BIT(packet->data, i);
+void ax25_stream_init(ax25_stream_t *stream, mod_t mod)
+{
+	stream->data = NULL;
+	stream->bits = 0;
+	stream->bit_cnt = 0;
+	stream->scramble = mod == MOD_2GFSK;
+	stream->lfsr = 0;
+	stream->tone = 0;
+}
+
+/**
+  * Sets the packet to be streamed. The scrambler and NRZI state is kept, so
+  * packets loaded one after another form one continuous transmission. The
+  * preamble of the first frame is skipped if skip_preamble is set.
+  */
+void ax25_stream_load(ax25_stream_t *stream, const uint8_t *data, bool skip_preamble)
+{
+	stream->data = data;
+	stream->pos = 0;
+	stream->flags = 0;
+	stream->bytes = 0;
+	stream->closing = false;
+	stream->skip_preamble = skip_preamble;
+}
+
+/**
+  * HDLC encodes the next flag or frame byte of the packet (bit stuffing)
+  */
+static void stream_hdlc(ax25_stream_t *stream)
+{
+	uint8_t cnt = 8;
+	uint32_t bits = 0;
+
+	if(stream->flags) { // Preamble or sync flag
+		bits = 0x7E;
+		stream->flags--;
+
+	} else if(stream->bytes) { // Frame byte
+		if(stream->fx25) { // Already encoded
+			bits = stream->data[stream->pos++];
 		} else {
-			AX25_CLEAR_BIT(packet->data, i);
+			uint16_t stuffed;
+			cnt = stuff_byte(stream->data[stream->pos++], &stream->ones_in_a_row, &stuffed);
+			bits = stuffed;
 		}
+		stream->bytes--;
+
+	} else if(stream->closing) { // End of frame flag
+		bits = 0x7E;
+		stream->closing = false;
+
+	} else if(stream->data != NULL && read_word(&stream->data[stream->pos]) != AX25_FRAME_END) { // Next frame
+		uint16_t preamble = read_word(&stream->data[stream->pos]);
+		stream->flags = (stream->skip_preamble ? 0 : preamble) + AX25_SYNC_FLAGS;
+		stream->bytes = read_word(&stream->data[stream->pos+2]);
+		stream->fx25 = stream->data[stream->pos+4] != 0;
+		stream->pos += AX25_FRAME_HEAD;
+		stream->closing = !stream->fx25;
+		stream->skip_preamble = false;
+		stream->ones_in_a_row = 0;
+		return;
 	}
+	// else: End of packet reached, fill with zeros
+
+	stream->bits |= bits << stream->bit_cnt;
+	stream->bit_cnt += cnt;
 }
 
 /**
-  * NRZ-I tone encoding (0: bit change, 1: no bit change)
+  * Returns the next num (1-8) bits of the transmission, LSB first. The bits
+  * are scrambled (2GFSK) and NRZI encoded (0: tone change, 1: no tone change).
   */
-void nrzi_encode(ax25_t *packet) {
-	uint8_t ctone = 0;
-	for(uint32_t i=0; i<packet->size; i++) {
-		if(((packet->data[i >> 3] >> (i & 0x7)) & 0x1) == 0)
-			ctone = !ctone;
-		if(ctone) {
-			AX25_WRITE_BIT(packet->data, i);
-		} else {
-			AX25_CLEAR_BIT(packet->data, i);
-		}
+uint8_t ax25_stream_get(ax25_stream_t *stream, uint8_t num)
+{
+	while(stream->bit_cnt < num)
+		stream_hdlc(stream);
+
+	uint32_t mask = (1 << num) - 1;
+	uint32_t bits = stream->bits & mask;
+	stream->bits >>= num;
+	stream->bit_cnt -= num;
+
+	// G3RUH scrambler (x^17 + x^12 + 1). Both taps are at least 12 bits back,
+	// so up to 8 bits can be scrambled at once from the previous output.
+	if(stream->scramble) {
+		bits = (bits ^ stream->lfsr ^ (stream->lfsr >> 5)) & mask;
+		stream->lfsr = (stream->lfsr >> num) | (bits << (17 - num));
 	}
+
+	// NRZI: The tone of each bit is the parity of the zeros up to it (prefix XOR)
+	uint32_t out = ~bits & mask;
+	out ^= out << 1;
+	out ^= out << 2;
+	out ^= out << 4;
+	out &= mask;
+	if(stream->tone)
+		out ^= mask;
+	stream->tone = (out >> (num - 1)) & 1;
+
+	return out;
 }
 
+/**
+  * Writes the scrambled and NRZI encoded packet into buffer (which must hold
+  * packet->size bits). This is the encoding the radio transmits.
+  */
+uint32_t ax25_encode_buffer(ax25_t *packet, uint8_t *buffer)
+{
+	ax25_stream_t stream;
+	ax25_stream_init(&stream, packet->mod);
+	ax25_stream_load(&stream, packet->data, false);
+
+	uint32_t i;
+	for(i=0; i+8<=packet->size; i+=8)
+		buffer[i >> 3] = ax25_stream_get(&stream, 8);
+	if(i < packet->size)
+		buffer[i >> 3] = ax25_stream_get(&stream, packet->size - i);
+
+	return packet->size;
+}
@@ -22,6 +22,9 @@
 #include "hal.h"
 #include "si4464.h"
 
+#define AX25_MAX_FRAME_LEN	330		// Addresses (10), control, PID, info field (256) and FCS in bytes
+#define AX25_MAX_FRAME_BITS	(AX25_MAX_FRAME_LEN * 8 * 6 / 5 + 8)	// Worst case bit stuffed frame with end flag (FX.25 blocks are smaller)
+
 typedef struct {
 	char callsign[7];
 	unsigned char ssid;
@@ -29,21 +32,44 @@ typedef struct {
 
 typedef struct {
 	uint8_t ones_in_a_row;	// Ones in a row (for bitstuffing)
-	uint8_t *data;			// Data
-	uint16_t size;			// Packet size in bits
-	uint16_t max_size;		// Max. Packet size in bits (size of modem packet)
+	uint8_t *data;			// Frame records (HDLC encoding is done by the stream)
+	uint16_t len;			// Bytes used in data
+	uint16_t frame;			// Position of the current frame record in data
+	uint32_t size;			// Packet size in bits (as transmitted)
+	uint32_t max_bits;		// Bit budget of the packet (frames exceeding it are dropped)
+	uint16_t preamble;		// Preamble size in bits
+	uint16_t max_size;		// Size of data in bytes
 	uint16_t crc;			// CRC
+	uint8_t fx25;			// FX.25 check bytes of the current frame (0: AX.25)
 	mod_t mod;				// Modulation type (MOD_AFSK or MOD_2GFSK)
 } ax25_t;
 
+typedef struct {
+	const uint8_t *data;	// Frame records
+	uint32_t pos;			// Read position in data
+	uint16_t flags;			// Flags to be sent before the frame
+	uint16_t bytes;			// Frame bytes left
+	bool closing;			// End of frame flag to be sent
+	bool fx25;				// Frame is an FX.25 block (no bit stuffing)
+	bool skip_preamble;		// Skip preamble of the next frame
+	uint8_t ones_in_a_row;	// Ones in a row (for bitstuffing)
+	uint32_t bits;			// HDLC encoded bits (LSB first)
+	uint8_t bit_cnt;		// Amount of bits in bits
+	bool scramble;			// Scrambling active (2GFSK)
+	uint32_t lfsr;			// Scrambler state (last 17 scrambled bits, oldest in bit 0)
+	uint8_t tone;			// NRZI state
+} ax25_stream_t;
+
 void ax25_init(ax25_t *packet);
-void ax25_send_header(ax25_t *packet, const char *callsign, uint8_t ssid, const char *path, uint16_t preamble);
+void ax25_send_header(ax25_t *packet, const char *callsign, uint8_t ssid, const char *path, uint16_t preamble, uint8_t fx25);
 void ax25_send_path(ax25_t *packet, const char *callsign, uint8_t ssid, bool last);
 void ax25_send_byte(ax25_t *packet, char byte);
 void ax25_send_string(ax25_t *packet, const char *string);
 void ax25_send_footer(ax25_t *packet);
-void scramble(ax25_t *packet);
-void nrzi_encode(ax25_t *packet);
+void ax25_stream_init(ax25_stream_t *stream, mod_t mod);
+void ax25_stream_load(ax25_stream_t *stream, const uint8_t *data, bool skip_preamble);
+uint8_t ax25_stream_get(ax25_stream_t *stream, uint8_t num);
+uint32_t ax25_encode_buffer(ax25_t *packet, uint8_t *buffer);
 
 #endif
 
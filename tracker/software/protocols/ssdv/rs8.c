@@ -8,6 +8,8 @@
 #include <string.h>
 #include "rs8.h"
 
+/* The antilog tables hold two periods (2*255 entries), so the sum of two
+ * logs can be looked up without reducing it modulo 255 */
 static const uint8_t ALPHA_TO[] = {
 0x01,0x02,0x04,0x08,0x10,0x20,0x40,0x80,0x87,0x89,0x95,0xAD,0xDD,0x3D,0x7A,0xF4,
 0x6F,0xDE,0x3B,0x76,0xEC,0x5F,0xBE,0xFB,0x71,0xE2,0x43,0x86,0x8B,0x91,0xA5,0xCD,
@@ -24,7 +26,23 @@ static const uint8_t ALPHA_TO[] = {
 0xB0,0xE7,0x49,0x92,0xA3,0xC1,0x05,0x0A,0x14,0x28,0x50,0xA0,0xC7,0x09,0x12,0x24,
 0x48,0x90,0xA7,0xC9,0x15,0x2A,0x54,0xA8,0xD7,0x29,0x52,0xA4,0xCF,0x19,0x32,0x64,
 0xC8,0x17,0x2E,0x5C,0xB8,0xF7,0x69,0xD2,0x23,0x46,0x8C,0x9F,0xB9,0xF5,0x6D,0xDA,
-0x33,0x66,0xCC,0x1F,0x3E,0x7C,0xF8,0x77,0xEE,0x5B,0xB6,0xEB,0x51,0xA2,0xC3,0x00,
+0x33,0x66,0xCC,0x1F,0x3E,0x7C,0xF8,0x77,0xEE,0x5B,0xB6,0xEB,0x51,0xA2,0xC3,0x01,
+0x02,0x04,0x08,0x10,0x20,0x40,0x80,0x87,0x89,0x95,0xAD,0xDD,0x3D,0x7A,0xF4,0x6F,
+0xDE,0x3B,0x76,0xEC,0x5F,0xBE,0xFB,0x71,0xE2,0x43,0x86,0x8B,0x91,0xA5,0xCD,0x1D,
+0x3A,0x74,0xE8,0x57,0xAE,0xDB,0x31,0x62,0xC4,0x0F,0x1E,0x3C,0x78,0xF0,0x67,0xCE,
+0x1B,0x36,0x6C,0xD8,0x37,0x6E,0xDC,0x3F,0x7E,0xFC,0x7F,0xFE,0x7B,0xF6,0x6B,0xD6,
+0x2B,0x56,0xAC,0xDF,0x39,0x72,0xE4,0x4F,0x9E,0xBB,0xF1,0x65,0xCA,0x13,0x26,0x4C,
+0x98,0xB7,0xE9,0x55,0xAA,0xD3,0x21,0x42,0x84,0x8F,0x99,0xB5,0xED,0x5D,0xBA,0xF3,
+0x61,0xC2,0x03,0x06,0x0C,0x18,0x30,0x60,0xC0,0x07,0x0E,0x1C,0x38,0x70,0xE0,0x47,
+0x8E,0x9B,0xB1,0xE5,0x4D,0x9A,0xB3,0xE1,0x45,0x8A,0x93,0xA1,0xC5,0x0D,0x1A,0x34,
+0x68,0xD0,0x27,0x4E,0x9C,0xBF,0xF9,0x75,0xEA,0x53,0xA6,0xCB,0x11,0x22,0x44,0x88,
+0x97,0xA9,0xD5,0x2D,0x5A,0xB4,0xEF,0x59,0xB2,0xE3,0x41,0x82,0x83,0x81,0x85,0x8D,
+0x9D,0xBD,0xFD,0x7D,0xFA,0x73,0xE6,0x4B,0x96,0xAB,0xD1,0x25,0x4A,0x94,0xAF,0xD9,
+0x35,0x6A,0xD4,0x2F,0x5E,0xBC,0xFF,0x79,0xF2,0x63,0xC6,0x0B,0x16,0x2C,0x58,0xB0,
+0xE7,0x49,0x92,0xA3,0xC1,0x05,0x0A,0x14,0x28,0x50,0xA0,0xC7,0x09,0x12,0x24,0x48,
+0x90,0xA7,0xC9,0x15,0x2A,0x54,0xA8,0xD7,0x29,0x52,0xA4,0xCF,0x19,0x32,0x64,0xC8,
+0x17,0x2E,0x5C,0xB8,0xF7,0x69,0xD2,0x23,0x46,0x8C,0x9F,0xB9,0xF5,0x6D,0xDA,0x33,
+0x66,0xCC,0x1F,0x3E,0x7C,0xF8,0x77,0xEE,0x5B,0xB6,0xEB,0x51,0xA2,0xC3,
 };
 
 static const uint8_t INDEX_OF[] = {
@@ -52,6 +70,80 @@ static const uint8_t GENPOLY[] = {
 0x00,
 };
 
+/* FX.25 codes: gfpoly 0x11D, fcr 1, prim 1 */
+static const uint8_t FX25_ALPHA_TO[] = {
+0x01,0x02,0x04,0x08,0x10,0x20,0x40,0x80,0x1D,0x3A,0x74,0xE8,0xCD,0x87,0x13,0x26,
+0x4C,0x98,0x2D,0x5A,0xB4,0x75,0xEA,0xC9,0x8F,0x03,0x06,0x0C,0x18,0x30,0x60,0xC0,
+0x9D,0x27,0x4E,0x9C,0x25,0x4A,0x94,0x35,0x6A,0xD4,0xB5,0x77,0xEE,0xC1,0x9F,0x23,
+0x46,0x8C,0x05,0x0A,0x14,0x28,0x50,0xA0,0x5D,0xBA,0x69,0xD2,0xB9,0x6F,0xDE,0xA1,
+0x5F,0xBE,0x61,0xC2,0x99,0x2F,0x5E,0xBC,0x65,0xCA,0x89,0x0F,0x1E,0x3C,0x78,0xF0,
+0xFD,0xE7,0xD3,0xBB,0x6B,0xD6,0xB1,0x7F,0xFE,0xE1,0xDF,0xA3,0x5B,0xB6,0x71,0xE2,
+0xD9,0xAF,0x43,0x86,0x11,0x22,0x44,0x88,0x0D,0x1A,0x34,0x68,0xD0,0xBD,0x67,0xCE,
+0x81,0x1F,0x3E,0x7C,0xF8,0xED,0xC7,0x93,0x3B,0x76,0xEC,0xC5,0x97,0x33,0x66,0xCC,
+0x85,0x17,0x2E,0x5C,0xB8,0x6D,0xDA,0xA9,0x4F,0x9E,0x21,0x42,0x84,0x15,0x2A,0x54,
+0xA8,0x4D,0x9A,0x29,0x52,0xA4,0x55,0xAA,0x49,0x92,0x39,0x72,0xE4,0xD5,0xB7,0x73,
+0xE6,0xD1,0xBF,0x63,0xC6,0x91,0x3F,0x7E,0xFC,0xE5,0xD7,0xB3,0x7B,0xF6,0xF1,0xFF,
+0xE3,0xDB,0xAB,0x4B,0x96,0x31,0x62,0xC4,0x95,0x37,0x6E,0xDC,0xA5,0x57,0xAE,0x41,
+0x82,0x19,0x32,0x64,0xC8,0x8D,0x07,0x0E,0x1C,0x38,0x70,0xE0,0xDD,0xA7,0x53,0xA6,
+0x51,0xA2,0x59,0xB2,0x79,0xF2,0xF9,0xEF,0xC3,0x9B,0x2B,0x56,0xAC,0x45,0x8A,0x09,
+0x12,0x24,0x48,0x90,0x3D,0x7A,0xF4,0xF5,0xF7,0xF3,0xFB,0xEB,0xCB,0x8B,0x0B,0x16,
+0x2C,0x58,0xB0,0x7D,0xFA,0xE9,0xCF,0x83,0x1B,0x36,0x6C,0xD8,0xAD,0x47,0x8E,0x01,
+0x02,0x04,0x08,0x10,0x20,0x40,0x80,0x1D,0x3A,0x74,0xE8,0xCD,0x87,0x13,0x26,0x4C,
+0x98,0x2D,0x5A,0xB4,0x75,0xEA,0xC9,0x8F,0x03,0x06,0x0C,0x18,0x30,0x60,0xC0,0x9D,
+0x27,0x4E,0x9C,0x25,0x4A,0x94,0x35,0x6A,0xD4,0xB5,0x77,0xEE,0xC1,0x9F,0x23,0x46,
+0x8C,0x05,0x0A,0x14,0x28,0x50,0xA0,0x5D,0xBA,0x69,0xD2,0xB9,0x6F,0xDE,0xA1,0x5F,
+0xBE,0x61,0xC2,0x99,0x2F,0x5E,0xBC,0x65,0xCA,0x89,0x0F,0x1E,0x3C,0x78,0xF0,0xFD,
+0xE7,0xD3,0xBB,0x6B,0xD6,0xB1,0x7F,0xFE,0xE1,0xDF,0xA3,0x5B,0xB6,0x71,0xE2,0xD9,
+0xAF,0x43,0x86,0x11,0x22,0x44,0x88,0x0D,0x1A,0x34,0x68,0xD0,0xBD,0x67,0xCE,0x81,
+0x1F,0x3E,0x7C,0xF8,0xED,0xC7,0x93,0x3B,0x76,0xEC,0xC5,0x97,0x33,0x66,0xCC,0x85,
+0x17,0x2E,0x5C,0xB8,0x6D,0xDA,0xA9,0x4F,0x9E,0x21,0x42,0x84,0x15,0x2A,0x54,0xA8,
+0x4D,0x9A,0x29,0x52,0xA4,0x55,0xAA,0x49,0x92,0x39,0x72,0xE4,0xD5,0xB7,0x73,0xE6,
+0xD1,0xBF,0x63,0xC6,0x91,0x3F,0x7E,0xFC,0xE5,0xD7,0xB3,0x7B,0xF6,0xF1,0xFF,0xE3,
+0xDB,0xAB,0x4B,0x96,0x31,0x62,0xC4,0x95,0x37,0x6E,0xDC,0xA5,0x57,0xAE,0x41,0x82,
+0x19,0x32,0x64,0xC8,0x8D,0x07,0x0E,0x1C,0x38,0x70,0xE0,0xDD,0xA7,0x53,0xA6,0x51,
+0xA2,0x59,0xB2,0x79,0xF2,0xF9,0xEF,0xC3,0x9B,0x2B,0x56,0xAC,0x45,0x8A,0x09,0x12,
+0x24,0x48,0x90,0x3D,0x7A,0xF4,0xF5,0xF7,0xF3,0xFB,0xEB,0xCB,0x8B,0x0B,0x16,0x2C,
+0x58,0xB0,0x7D,0xFA,0xE9,0xCF,0x83,0x1B,0x36,0x6C,0xD8,0xAD,0x47,0x8E,
+};
+
+static const uint8_t FX25_INDEX_OF[] = {
+0xFF,0x00,0x01,0x19,0x02,0x32,0x1A,0xC6,0x03,0xDF,0x33,0xEE,0x1B,0x68,0xC7,0x4B,
+0x04,0x64,0xE0,0x0E,0x34,0x8D,0xEF,0x81,0x1C,0xC1,0x69,0xF8,0xC8,0x08,0x4C,0x71,
+0x05,0x8A,0x65,0x2F,0xE1,0x24,0x0F,0x21,0x35,0x93,0x8E,0xDA,0xF0,0x12,0x82,0x45,
+0x1D,0xB5,0xC2,0x7D,0x6A,0x27,0xF9,0xB9,0xC9,0x9A,0x09,0x78,0x4D,0xE4,0x72,0xA6,
+0x06,0xBF,0x8B,0x62,0x66,0xDD,0x30,0xFD,0xE2,0x98,0x25,0xB3,0x10,0x91,0x22,0x88,
+0x36,0xD0,0x94,0xCE,0x8F,0x96,0xDB,0xBD,0xF1,0xD2,0x13,0x5C,0x83,0x38,0x46,0x40,
+0x1E,0x42,0xB6,0xA3,0xC3,0x48,0x7E,0x6E,0x6B,0x3A,0x28,0x54,0xFA,0x85,0xBA,0x3D,
+0xCA,0x5E,0x9B,0x9F,0x0A,0x15,0x79,0x2B,0x4E,0xD4,0xE5,0xAC,0x73,0xF3,0xA7,0x57,
+0x07,0x70,0xC0,0xF7,0x8C,0x80,0x63,0x0D,0x67,0x4A,0xDE,0xED,0x31,0xC5,0xFE,0x18,
+0xE3,0xA5,0x99,0x77,0x26,0xB8,0xB4,0x7C,0x11,0x44,0x92,0xD9,0x23,0x20,0x89,0x2E,
+0x37,0x3F,0xD1,0x5B,0x95,0xBC,0xCF,0xCD,0x90,0x87,0x97,0xB2,0xDC,0xFC,0xBE,0x61,
+0xF2,0x56,0xD3,0xAB,0x14,0x2A,0x5D,0x9E,0x84,0x3C,0x39,0x53,0x47,0x6D,0x41,0xA2,
+0x1F,0x2D,0x43,0xD8,0xB7,0x7B,0xA4,0x76,0xC4,0x17,0x49,0xEC,0x7F,0x0C,0x6F,0xF6,
+0x6C,0xA1,0x3B,0x52,0x29,0x9D,0x55,0xAA,0xFB,0x60,0x86,0xB1,0xBB,0xCC,0x3E,0x5A,
+0xCB,0x59,0x5F,0xB0,0x9C,0xA9,0xA0,0x51,0x0B,0xF5,0x16,0xEB,0x7A,0x75,0x2C,0xD7,
+0x4F,0xAE,0xD5,0xE9,0xE6,0xE7,0xAD,0xE8,0x74,0xD6,0xF4,0xEA,0xA8,0x50,0x58,0xAF,
+};
+
+static const uint8_t FX25_GENPOLY_16[] = {
+0x88,0xF0,0xD0,0xC3,0xB5,0x9E,0xC9,0x64,0x0B,0x53,0xA7,0x6B,0x71,0x6E,0x6A,0x79,
+0x00,
+};
+
+static const uint8_t FX25_GENPOLY_32[] = {
+0x12,0xFB,0xD7,0x1C,0x50,0x6B,0xF8,0x35,0x54,0xC2,0x5B,0x3B,0xB0,0x63,0xCB,0x89,
+0x2B,0x68,0x89,0x00,0x2C,0x95,0x94,0xDA,0x4B,0x0B,0xAD,0xFE,0xC2,0x6D,0x08,0x0B,
+0x00,
+};
+
+static const uint8_t FX25_GENPOLY_64[] = {
+0x28,0x15,0xDA,0x17,0x30,0xED,0x45,0x06,0x57,0x2A,0x1D,0xC1,0xA0,0x96,0x71,0x20,
+0x23,0xAC,0xF1,0xF0,0xB8,0x5A,0xBC,0xE1,0x57,0x82,0xFE,0x29,0xF5,0xFD,0xB8,0xF1,
+0xBC,0xB0,0x36,0x3A,0xF0,0xE2,0x77,0xB9,0x4D,0x96,0x30,0x8C,0xA9,0xA0,0x60,0xD9,
+0x0F,0xCA,0xDA,0xBE,0x87,0x67,0x81,0x4D,0x39,0xA6,0xA4,0x0C,0x0D,0xB2,0x35,0x2E,
+0x00,
+};
+
 static inline int mod255(int x)
 {
 	while(x >= 255)
@@ -73,30 +165,62 @@ static inline int mod255(int x)
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define A0       (NN) /* Special reserved value encoding zero in index form */
 
-/* Portable C version */
-void encode_rs_8(uint8_t *data, uint8_t *parity, int pad)
+/* CCSDS code used by SSDV: gfpoly 0x187, fcr 112, prim 11 */
+static const rs8_code_t RS8_CCSDS = {ALPHA_TO, INDEX_OF, GENPOLY, NROOTS};
+
+const rs8_code_t RS8_FX25_16 = {FX25_ALPHA_TO, FX25_INDEX_OF, FX25_GENPOLY_16, 16};
+const rs8_code_t RS8_FX25_32 = {FX25_ALPHA_TO, FX25_INDEX_OF, FX25_GENPOLY_32, 32};
+const rs8_code_t RS8_FX25_64 = {FX25_ALPHA_TO, FX25_INDEX_OF, FX25_GENPOLY_64, 64};
+
+/* Portable C version
+ *
+ * The shift register is circular: head points to its first symbol, which
+ * becomes the last one after each step. This saves moving all parity
+ * symbols for every data byte.
+ */
+void encode_rs_8_code(const rs8_code_t *rs, const uint8_t *data, uint8_t *parity, int pad)
 {
-	int i, j;
-	uint8_t feedback;
+	int i, head;
+	uint8_t feedback, reg[RS8_MAX_NROOTS];
+	uint8_t *r, *end;
+	const uint8_t *alpha_to = rs->alpha_to;
+	const uint8_t *index_of = rs->index_of;
+	const uint8_t *g, *genpoly = rs->genpoly;
+	int nroots = rs->nroots;
 	
-	memset(parity, 0, NROOTS * sizeof(uint8_t));
+	memset(reg, 0, nroots * sizeof(uint8_t));
 	
-	for(i = 0; i < NN - NROOTS - pad; i++)
+	for(i = 0, head = 0; i < NN - nroots - pad; i++)
 	{
-		feedback = INDEX_OF[data[i] ^ parity[0]];
+		feedback = index_of[data[i] ^ reg[head]];
 		if(feedback != A0) /* feedback term is non-zero */
 		{
-			for(j = 1; j < NROOTS; j++)
-				parity[j] ^= ALPHA_TO[mod255(feedback + GENPOLY[NROOTS - j])];
+			/* reg[head+j] ^= alpha^(feedback+genpoly[nroots-j]) for j=1..nroots-1 */
+			g = &genpoly[nroots - 1];
+			for(r = &reg[head + 1], end = &reg[nroots]; r < end; r++)
+				*r ^= alpha_to[feedback + *(g--)];
+			for(r = reg, end = &reg[head]; r < end; r++)
+				*r ^= alpha_to[feedback + *(g--)];
+			
+			reg[head] = alpha_to[feedback + genpoly[0]];
+		}
+		else
+		{
+			reg[head] = 0;
 		}
 		
 		/* Shift */
-		memmove(&parity[0], &parity[1], sizeof(uint8_t) * (NROOTS - 1));
-		if(feedback != A0)
-			parity[NROOTS - 1] = ALPHA_TO[mod255(feedback + GENPOLY[0])];
-		else
-			parity[NROOTS - 1] = 0;
+		if(++head == nroots) head = 0;
 	}
+	
+	/* Unroll the register into the parity symbols */
+	memcpy(parity, &reg[head], (nroots - head) * sizeof(uint8_t));
+	memcpy(&parity[nroots - head], reg, head * sizeof(uint8_t));
+}
+
+void encode_rs_8(uint8_t *data, uint8_t *parity, int pad)
+{
+	encode_rs_8_code(&RS8_CCSDS, data, parity, pad);
 }
 
 int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad)
@@ -108,10 +232,16 @@ int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad)
 	                                        * and syndrome poly */
 	uint8_t b[NROOTS + 1], t[NROOTS + 1], omega[NROOTS + 1];
 	uint8_t root[NROOTS], reg[NROOTS + 1], loc[NROOTS];
+	uint8_t roots[NROOTS];
 	int syn_error, count;
 	
 	if(pad < 0 || pad > 222) return(-1);
 	
+	/* Roots of g(x) in index form */
+	roots[0] = MODNN(FCR * PRIM);
+	for(i = 1; i < NROOTS; i++)
+		roots[i] = MODNN(roots[i - 1] + PRIM);
+	
 	/* form the syndromes; i.e., evaluate data(x) at roots of g(x) */
 	for(i = 0; i < NROOTS; i++) s[i] = data[0];
 	
@@ -120,7 +250,7 @@ int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad)
 		for(i = 0; i < NROOTS; i++)
 		{
 			if(s[i] == 0) s[i] = data[j];
-			else s[i] = data[j] ^ ALPHA_TO[MODNN(INDEX_OF[s[i]] + (FCR + i) * PRIM)];
+			else s[i] = data[j] ^ ALPHA_TO[INDEX_OF[s[i]] + roots[i]];
 		}
 	}
 	
@@ -177,7 +307,7 @@ int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad)
 		{
 			if((lambda[i] != 0) && (s[r - i - 1] != A0))
 			{
-				discr_r ^= ALPHA_TO[MODNN(INDEX_OF[lambda[i]] + s[r - i - 1])];
+				discr_r ^= ALPHA_TO[INDEX_OF[lambda[i]] + s[r - i - 1]];
 			}
 		}
 		discr_r = INDEX_OF[discr_r]; /* Index form */
@@ -194,7 +324,7 @@ int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad)
 			for(i = 0; i < NROOTS; i++)
 			{
 				if(b[i] != A0)
-					t[i + 1] = lambda[i + 1] ^ ALPHA_TO[MODNN(discr_r + b[i])];
+					t[i + 1] = lambda[i + 1] ^ ALPHA_TO[discr_r + b[i]];
 				else
 					t[i + 1] = lambda[i + 1];
 			}
@@ -238,8 +368,9 @@ int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad)
 		{
 			if(reg[j] != A0)
 			{
-				reg[j] = MODNN(reg[j] + j);
-				q ^= ALPHA_TO[reg[j]];
+				tmp = reg[j] + j < NN ? reg[j] + j : reg[j] + j - NN;
+				reg[j] = tmp;
+				q ^= ALPHA_TO[tmp];
 			}
 		}
 		
@@ -275,7 +406,7 @@ int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad)
 		for(j = i; j >= 0; j--)
 		{
 			if((s[i - j] != A0) && (lambda[j] != A0))
-				tmp ^= ALPHA_TO[MODNN(s[i - j] + lambda[j])];
+				tmp ^= ALPHA_TO[s[i - j] + lambda[j]];
 		}
 		omega[i] = INDEX_OF[tmp];
 	}
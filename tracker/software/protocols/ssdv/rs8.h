@@ -13,6 +13,22 @@ extern "C" {
 
 #include <stdint.h>
 
+#define RS8_MAX_NROOTS (64)
+
+/* Reed-Solomon code over GF(256) */
+typedef struct {
+	const uint8_t *alpha_to;	/* Antilog table of the field (2*255 entries) */
+	const uint8_t *index_of;	/* Log table of the field */
+	const uint8_t *genpoly;		/* Generator polynomial (index form) */
+	int nroots;					/* Number of parity symbols (up to RS8_MAX_NROOTS) */
+} rs8_code_t;
+
+/* FX.25 codes with 16, 32 and 64 parity symbols */
+extern const rs8_code_t RS8_FX25_16;
+extern const rs8_code_t RS8_FX25_32;
+extern const rs8_code_t RS8_FX25_64;
+
+extern void encode_rs_8_code(const rs8_code_t *rs, const uint8_t *data, uint8_t *parity, int pad);
 extern void encode_rs_8(uint8_t *data, uint8_t *parity, int pad);
 extern int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad);
 
@@ -19,8 +19,10 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <math.h>
 #include "ssdv.h"
 #include "rs8.h"
+#include "pcrc.h"
 #include "debug.h"
 
 /* Recognised JPEG markers */
@@ -37,22 +39,22 @@ enum {
 } jpeg_marker_t;
 
 /* APP0 header data */
-static const uint8_t const app0[14] = {
+static const uint8_t app0[14] = {
 0x4A,0x46,0x49,0x46,0x00,0x01,0x01,0x01,0x00,0x48,0x00,0x48,0x00,0x00,
 };
 
 /* SOS header data */
-static const uint8_t const sos[10] = {
+static const uint8_t sos[10] = {
 0x03,0x01,0x00,0x02,0x11,0x03,0x11,0x00,0x3F,0x00,
 };
 
 /* Quantisation table scaling factors for each quality level 0-7 */
-static const uint16_t const dqt_scales[8] = {
+static const uint16_t dqt_scales[8] = {
 5000, 357, 172, 116, 100, 58, 28, 0
 };
 
 /* Quantisation tables */
-static const uint8_t const std_dqt0[65] = {
+static const uint8_t std_dqt0[65] = {
 0x00,0x10,0x0C,0x0C,0x0E,0x0C,0x0A,0x10,0x0E,0x0E,0x0E,0x12,0x12,0x10,0x14,0x18,
 0x28,0x1A,0x18,0x16,0x16,0x18,0x32,0x24,0x26,0x1E,0x28,0x3A,0x34,0x3E,0x3C,0x3A,
 0x34,0x38,0x38,0x40,0x48,0x5C,0x4E,0x40,0x44,0x58,0x46,0x38,0x38,0x50,0x6E,0x52,
@@ -60,7 +62,7 @@ static const uint8_t const std_dqt0[65] = {
 0x64,
 };
 
-static const uint8_t const std_dqt1[65] = {
+static const uint8_t std_dqt1[65] = {
 0x01,0x12,0x12,0x12,0x16,0x16,0x16,0x30,0x1A,0x1A,0x30,0x64,0x42,0x38,0x42,0x64,
 0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,
 0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,0x64,
@@ -68,6 +70,36 @@ static const uint8_t const std_dqt1[65] = {
 0x64,
 };
 
+/* Reduced IDCT basis of the thumbnail scales 1, 2 and 4 [pixel][frequency],
+ * C(u) / 2 * cos((2x + 1) * u * pi / (2 * scale)) in Q15 */
+static const int16_t thumb_idct[3][4][4] = {
+	{ { 11585,      0,      0,      0 } },
+	{ { 11585,  11585,      0,      0 },
+	  { 11585, -11585,      0,      0 } },
+	{ { 11585,  15137,  11585,   6270 },
+	  { 11585,   6270, -11585, -15137 },
+	  { 11585,  -6270, -11585,  15137 },
+	  { 11585, -15137,  11585,  -6270 } },
+};
+
+/* FDCT basis [frequency][pixel], C(u) / 2 * cos((2x + 1) * u * pi / 16) in Q15 */
+static const int16_t thumb_fdct[8][8] = {
+	{ 11585,  11585,  11585,  11585,  11585,  11585,  11585,  11585 },
+	{ 16069,  13623,   9102,   3196,  -3196,  -9102, -13623, -16069 },
+	{ 15137,   6270,  -6270, -15137, -15137,  -6270,   6270,  15137 },
+	{ 13623,  -3196, -16069,  -9102,   9102,  16069,   3196, -13623 },
+	{ 11585, -11585, -11585,  11585,  11585, -11585, -11585,  11585 },
+	{  9102, -16069,   3196,  13623, -13623,  -3196,  16069,  -9102 },
+	{  6270, -15137,  15137,  -6270,  -6270,  15137, -15137,   6270 },
+	{  3196,  -9102,  13623, -16069,  16069, -13623,   9102,  -3196 },
+};
+
+/* Natural order index of each zigzag position */
+static const uint8_t zigzag[64] = {
+ 0, 1, 8,16, 9, 2, 3,10,17,24,32,25,18,11, 4, 5,12,19,26,33,40,48,41,34,27,20,13, 6, 7,14,21,28,
+35,42,49,56,57,50,43,36,29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,47,55,62,63,
+};
+
 /* Standard Huffman tables */
 static const uint8_t std_dht00[29] = {
 0x00,0x00,0x01,0x05,0x01,0x01,0x01,0x01,0x01,0x01,0x00,0x00,0x00,0x00,0x00,0x00,
@@ -109,9 +141,175 @@ static const uint8_t std_dht11[179] = {
 0xF8,0xF9,0xFA,
 };
 
+/* Code (bits 0-15) and width (bits 16-20) of each symbol of the standard
+ * Huffman tables, a width of 0 means the symbol has no code */
+static const uint32_t std_dht00_codes[16] = {
+0x020000,0x030002,0x030003,0x030004,0x030005,0x030006,0x04000E,0x05001E,
+0x06003E,0x07007E,0x0800FE,0x0901FE,0x000000,0x000000,0x000000,0x000000,
+};
+
+static const uint32_t std_dht01_codes[16] = {
+0x020000,0x020001,0x020002,0x030006,0x04000E,0x05001E,0x06003E,0x07007E,
+0x0800FE,0x0901FE,0x0A03FE,0x0B07FE,0x000000,0x000000,0x000000,0x000000,
+};
+
+static const uint32_t std_dht10_codes[256] = {
+0x04000A,0x020000,0x020001,0x030004,0x04000B,0x05001A,0x070078,0x0800F8,
+0x0A03F6,0x10FF82,0x10FF83,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x04000C,0x05001B,0x070079,0x0901F6,0x0B07F6,0x10FF84,0x10FF85,
+0x10FF86,0x10FF87,0x10FF88,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x05001C,0x0800F9,0x0A03F7,0x0C0FF4,0x10FF89,0x10FF8A,0x10FF8B,
+0x10FF8C,0x10FF8D,0x10FF8E,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x06003A,0x0901F7,0x0C0FF5,0x10FF8F,0x10FF90,0x10FF91,0x10FF92,
+0x10FF93,0x10FF94,0x10FF95,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x06003B,0x0A03F8,0x10FF96,0x10FF97,0x10FF98,0x10FF99,0x10FF9A,
+0x10FF9B,0x10FF9C,0x10FF9D,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x07007A,0x0B07F7,0x10FF9E,0x10FF9F,0x10FFA0,0x10FFA1,0x10FFA2,
+0x10FFA3,0x10FFA4,0x10FFA5,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x07007B,0x0C0FF6,0x10FFA6,0x10FFA7,0x10FFA8,0x10FFA9,0x10FFAA,
+0x10FFAB,0x10FFAC,0x10FFAD,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0800FA,0x0C0FF7,0x10FFAE,0x10FFAF,0x10FFB0,0x10FFB1,0x10FFB2,
+0x10FFB3,0x10FFB4,0x10FFB5,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0901F8,0x0F7FC0,0x10FFB6,0x10FFB7,0x10FFB8,0x10FFB9,0x10FFBA,
+0x10FFBB,0x10FFBC,0x10FFBD,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0901F9,0x10FFBE,0x10FFBF,0x10FFC0,0x10FFC1,0x10FFC2,0x10FFC3,
+0x10FFC4,0x10FFC5,0x10FFC6,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0901FA,0x10FFC7,0x10FFC8,0x10FFC9,0x10FFCA,0x10FFCB,0x10FFCC,
+0x10FFCD,0x10FFCE,0x10FFCF,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0A03F9,0x10FFD0,0x10FFD1,0x10FFD2,0x10FFD3,0x10FFD4,0x10FFD5,
+0x10FFD6,0x10FFD7,0x10FFD8,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0A03FA,0x10FFD9,0x10FFDA,0x10FFDB,0x10FFDC,0x10FFDD,0x10FFDE,
+0x10FFDF,0x10FFE0,0x10FFE1,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0B07F8,0x10FFE2,0x10FFE3,0x10FFE4,0x10FFE5,0x10FFE6,0x10FFE7,
+0x10FFE8,0x10FFE9,0x10FFEA,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x10FFEB,0x10FFEC,0x10FFED,0x10FFEE,0x10FFEF,0x10FFF0,0x10FFF1,
+0x10FFF2,0x10FFF3,0x10FFF4,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x0B07F9,0x10FFF5,0x10FFF6,0x10FFF7,0x10FFF8,0x10FFF9,0x10FFFA,0x10FFFB,
+0x10FFFC,0x10FFFD,0x10FFFE,0x000000,0x000000,0x000000,0x000000,0x000000,
+};
+
+static const uint32_t std_dht11_codes[256] = {
+0x020000,0x020001,0x030004,0x04000A,0x050018,0x050019,0x060038,0x070078,
+0x0901F4,0x0A03F6,0x0C0FF4,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x04000B,0x060039,0x0800F6,0x0901F5,0x0B07F6,0x0C0FF5,0x10FF88,
+0x10FF89,0x10FF8A,0x10FF8B,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x05001A,0x0800F7,0x0A03F7,0x0C0FF6,0x0F7FC2,0x10FF8C,0x10FF8D,
+0x10FF8E,0x10FF8F,0x10FF90,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x05001B,0x0800F8,0x0A03F8,0x0C0FF7,0x10FF91,0x10FF92,0x10FF93,
+0x10FF94,0x10FF95,0x10FF96,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x06003A,0x0901F6,0x10FF97,0x10FF98,0x10FF99,0x10FF9A,0x10FF9B,
+0x10FF9C,0x10FF9D,0x10FF9E,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x06003B,0x0A03F9,0x10FF9F,0x10FFA0,0x10FFA1,0x10FFA2,0x10FFA3,
+0x10FFA4,0x10FFA5,0x10FFA6,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x070079,0x0B07F7,0x10FFA7,0x10FFA8,0x10FFA9,0x10FFAA,0x10FFAB,
+0x10FFAC,0x10FFAD,0x10FFAE,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x07007A,0x0B07F8,0x10FFAF,0x10FFB0,0x10FFB1,0x10FFB2,0x10FFB3,
+0x10FFB4,0x10FFB5,0x10FFB6,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0800F9,0x10FFB7,0x10FFB8,0x10FFB9,0x10FFBA,0x10FFBB,0x10FFBC,
+0x10FFBD,0x10FFBE,0x10FFBF,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0901F7,0x10FFC0,0x10FFC1,0x10FFC2,0x10FFC3,0x10FFC4,0x10FFC5,
+0x10FFC6,0x10FFC7,0x10FFC8,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0901F8,0x10FFC9,0x10FFCA,0x10FFCB,0x10FFCC,0x10FFCD,0x10FFCE,
+0x10FFCF,0x10FFD0,0x10FFD1,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0901F9,0x10FFD2,0x10FFD3,0x10FFD4,0x10FFD5,0x10FFD6,0x10FFD7,
+0x10FFD8,0x10FFD9,0x10FFDA,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0901FA,0x10FFDB,0x10FFDC,0x10FFDD,0x10FFDE,0x10FFDF,0x10FFE0,
+0x10FFE1,0x10FFE2,0x10FFE3,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0B07F9,0x10FFE4,0x10FFE5,0x10FFE6,0x10FFE7,0x10FFE8,0x10FFE9,
+0x10FFEA,0x10FFEB,0x10FFEC,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x000000,0x0E3FE0,0x10FFED,0x10FFEE,0x10FFEF,0x10FFF0,0x10FFF1,0x10FFF2,
+0x10FFF3,0x10FFF4,0x10FFF5,0x000000,0x000000,0x000000,0x000000,0x000000,
+0x0A03FA,0x0F7FC3,0x10FFF6,0x10FFF7,0x10FFF8,0x10FFF9,0x10FFFA,0x10FFFB,
+0x10FFFC,0x10FFFD,0x10FFFE,0x000000,0x000000,0x000000,0x000000,0x000000,
+};
+
+/* Width of the code the next SSDV_HUFF_FAST_BITS bits start with for each
+ * standard Huffman table, 0 means a longer code. Tables which differ from the
+ * standard tables are decoded without them. */
+static const uint8_t std_dht00_fast[1 << SSDV_HUFF_FAST_BITS] = {
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,6,6,6,6,6,6,6,6,7,7,7,7,8,8,9,0,
+};
+
+static const uint8_t std_dht01_fast[1 << SSDV_HUFF_FAST_BITS] = {
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,6,6,6,6,6,6,6,6,7,7,7,7,8,8,9,0,
+};
+
+static const uint8_t std_dht10_fast[1 << SSDV_HUFF_FAST_BITS] = {
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,8,8,8,8,8,8,9,9,9,9,9,0,0,0,0,0,
+};
+
+static const uint8_t std_dht11_fast[1 << SSDV_HUFF_FAST_BITS] = {
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+7,7,7,7,7,7,7,7,7,7,7,7,8,8,8,8,8,8,8,8,9,9,9,9,9,9,9,0,0,0,0,0,
+};
+
 /* Helper for returning the current DHT table */
 #define SDHT (s->sdht[s->acpart ? 1 : 0][s->component ? 1 : 0])
 #define DDHT (s->ddht[s->acpart ? 1 : 0][s->component ? 1 : 0])
+#define SHUFF (&s->shuff[s->acpart ? 1 : 0][s->component ? 1 : 0])
+
+/* The output tables are always the standard tables */
+#define DCODES (s->acpart ? (s->component ? std_dht11_codes : std_dht10_codes) \
+                          : (s->component ? std_dht01_codes : std_dht00_codes))
 
 /* Helpers for looking up the current DQT value */
 #define SDQT (s->sdqt[s->component ? 1 : 0][1 + s->acpart])
@@ -214,25 +412,6 @@ static void *dtblcpy(ssdv_t *s, const void *src, size_t n)
 	return(r);
 }
 
-static uint32_t crc32(void *data, size_t length)
-{
-	uint32_t crc, x;
-	uint8_t i, *d;
-	
-	for(d = data, crc = 0xFFFFFFFF; length; length--)
-	{
-		x = (crc ^ *(d++)) & 0xFF;
-		for(i = 8; i > 0; i--)
-		{
-			if(x & 1) x = (x >> 1) ^ 0xEDB88320;
-			else x >>= 1;
-		}
-		crc = (crc >> 8) ^ x;
-	}
-	
-	return(crc ^ 0xFFFFFFFF);
-}
-
 static uint32_t encode_callsign(char *callsign)
 {
 	uint32_t x;
@@ -277,35 +456,71 @@ static char *decode_callsign(char *callsign, uint32_t code)
 	return(callsign);
 }
 
-static inline char jpeg_dht_lookup(ssdv_t *s, uint8_t *symbol, uint8_t *width)
+static void jpeg_dht_build(ssdv_huff_t *h, const uint8_t *dht,
+                           const uint8_t *std, size_t std_len, const uint8_t *std_fast)
 {
-	uint16_t code = 0;
-	uint8_t cw, n;
-	uint8_t *dht, *ss;
+	uint16_t code = 0, k = 0;
+	uint8_t cw;
+	
+	h->symbols = &dht[17];
 	
-	/* Select the appropriate huffman table */
-	dht = SDHT;
-	ss = &dht[17];
+	/* The single lookup table is only available for the standard tables */
+	h->fast = memcmp(&dht[1], &std[1], 16) == 0 &&
+	          memcmp(&dht[17], &std[17], std_len - 17) == 0 ? std_fast : NULL;
 	
 	for(cw = 1; cw <= 16; cw++)
+	{
+		h->maxcode[cw] = dht[cw] ? code + dht[cw] - 1 : -1;
+		h->delta[cw] = k - code;
+		
+		code += dht[cw];
+		k += dht[cw];
+		code <<= 1;
+	}
+}
+
+static void jpeg_dht_build_all(ssdv_t *s)
+{
+	jpeg_dht_build(&s->shuff[0][0], s->sdht[0][0], std_dht00, sizeof(std_dht00), std_dht00_fast);
+	jpeg_dht_build(&s->shuff[0][1], s->sdht[0][1], std_dht01, sizeof(std_dht01), std_dht01_fast);
+	jpeg_dht_build(&s->shuff[1][0], s->sdht[1][0], std_dht10, sizeof(std_dht10), std_dht10_fast);
+	jpeg_dht_build(&s->shuff[1][1], s->sdht[1][1], std_dht11, sizeof(std_dht11), std_dht11_fast);
+}
+
+static inline char jpeg_dht_lookup(ssdv_t *s, uint8_t *symbol, uint8_t *width)
+{
+	ssdv_huff_t *h = SHUFF;
+	int32_t code;
+	uint8_t cw = 1;
+	
+	/* Codes up to SSDV_HUFF_FAST_BITS wide are found with a single lookup */
+	if(h->fast && s->worklen >= SSDV_HUFF_FAST_BITS)
+	{
+		code = s->workbits >> (s->worklen - SSDV_HUFF_FAST_BITS);
+		cw = h->fast[code];
+		if(cw)
+		{
+			*symbol = h->symbols[(code >> (SSDV_HUFF_FAST_BITS - cw)) + h->delta[cw]];
+			*width = cw;
+			return(SSDV_OK);
+		}
+		cw = SSDV_HUFF_FAST_BITS + 1;
+	}
+	
+	for(; cw <= 16; cw++)
 	{
 		/* Got enough bits? */
 		if(cw > s->worklen) return(SSDV_FEED_ME);
 		
-		/* Compare against each code 'cw' bits wide */
-		for(n = dht[cw]; n > 0; n--)
+		/* Codes are ascending, the first 'cw' bits are a code if they
+		 * don't exceed the largest code 'cw' bits wide */
+		code = s->workbits >> (s->worklen - cw);
+		if(code <= h->maxcode[cw])
 		{
-			if(s->workbits >> (s->worklen - cw) == code)
-			{
-				/* Found a match */
-				*symbol = *ss;
-				*width = cw;
-				return(SSDV_OK);
-			}
-			ss++; code++;
+			*symbol = h->symbols[code + h->delta[cw]];
+			*width = cw;
+			return(SSDV_OK);
 		}
-		
-		code <<= 1;
 	}
 	
 	/* No match found - error */
@@ -314,32 +529,16 @@ static inline char jpeg_dht_lookup(ssdv_t *s, uint8_t *symbol, uint8_t *width)
 
 static inline char jpeg_dht_lookup_symbol(ssdv_t *s, uint8_t symbol, uint16_t *bits, uint8_t *width)
 {
-	uint16_t code = 0;
-	uint8_t cw, n;
-	uint8_t *dht, *ss;
+	const uint32_t *codes = DCODES;
 	
-	dht = DDHT;
-	ss = &dht[17];
+	/* The DC tables have codes for symbols 0-11 only */
+	if(s->acpart == 0 && symbol > 0x0F) return(SSDV_ERROR);
+	if(!(codes[symbol] >> 16)) return(SSDV_ERROR);
 	
-	for(cw = 1; cw <= 16; cw++)
-	{
-		for(n = dht[cw]; n > 0; n--)
-		{
-			if(*ss == symbol)
-			{
-				/* Found a match */
-				*bits = code;
-				*width = cw;
-				return(SSDV_OK);
-			}
-			ss++; code++;
-		}
-		
-		code <<= 1;
-	}
+	*bits = codes[symbol] & 0xFFFF;
+	*width = codes[symbol] >> 16;
 	
-	/* No match found - error */
-	return(SSDV_ERROR);
+	return(SSDV_OK);
 }
 
 static inline int jpeg_int(int bits, int width)
@@ -419,6 +618,99 @@ static char ssdv_out_jpeg_int(ssdv_t *s, uint8_t rle, int value)
 	return(SSDV_OK);
 }
 
+static int32_t ssdv_thumb_coef(int32_t c)
+{
+	/* Limits a dequantized coefficient to the range of 8-bit samples, which
+	 * keeps the integer IDCT of the thumbnail within 32 bits */
+	return(c < -2048 ? -2048 : (c > 2047 ? 2047 : c));
+}
+
+static void ssdv_collect_dc(ssdv_t *s)
+{
+	/* Collects the dequantized DC of each block for the thumbnail and the
+	 * luminance statistics (block mean, -128 to 127) */
+	int32_t dc, m;
+	
+	if(s->mode != S_ENCODING) return;
+	
+	dc = SDQT == DDQT ? s->dc[s->component] * SDQT : s->dc[s->component];
+	if(s->thumb) s->thumb_coef[0] = ssdv_thumb_coef(dc);
+	
+	if(s->component != 0) return;
+	
+	m = dc / 8;
+	s->dc_sum += m;
+	s->dc_sqsum += m * m;
+	s->dc_count++;
+}
+
+static void ssdv_thumb_geometry(ssdv_t *s, uint8_t *h, uint8_t *v, uint16_t *yw, uint16_t *yh, uint16_t *cw, uint16_t *ch)
+{
+	/* Sampling factors of Y (see ssdv_have_marker_data) */
+	*h = s->mcu_mode == 0 || s->mcu_mode == 2 ? 2 : 1;
+	*v = s->mcu_mode == 0 || s->mcu_mode == 1 ? 2 : 1;
+	
+	/* Plane sizes in pixels, one pixel per block at scale 1 */
+	*cw = s->width / (8 * *h) * s->thumb_scale;
+	*ch = s->height / (8 * *v) * s->thumb_scale;
+	*yw = *cw * *h;
+	*yh = *ch * *v;
+}
+
+static void ssdv_thumb_block(ssdv_t *s)
+{
+	/* Downscales the completed block with a reduced IDCT of its low order
+	 * coefficients and stores the pixels in the thumbnail planes */
+	const int16_t (*idct)[4] = thumb_idct[s->thumb_scale >> 1];
+	uint8_t h, v, n = s->thumb_scale;
+	uint16_t yw, yh, cw, ch, pw, bx, by, mx;
+	uint8_t *plane;
+	int32_t t[4][4], p;
+	int x, y, u, w;
+	
+	ssdv_thumb_geometry(s, &h, &v, &yw, &yh, &cw, &ch);
+	mx = cw / n;
+	
+	if(s->component == 0)
+	{
+		bx = (s->mcu_id % mx) * h + s->mcupart % h;
+		by = (s->mcu_id / mx) * v + s->mcupart / h;
+		plane = s->thumb;
+		pw = yw;
+	}
+	else
+	{
+		bx = s->mcu_id % mx;
+		by = s->mcu_id / mx;
+		plane = &s->thumb[yw * yh + (s->component - 1) * cw * ch];
+		pw = cw;
+	}
+	
+	/* Separable IDCT, rows then columns. The rows are kept in Q3, the
+	 * pixels are in Q18 before rounding. */
+	for(w = 0; w < n; w++)
+		for(x = 0; x < n; x++)
+		{
+			p = 0;
+			for(u = 0; u < n; u++) p += idct[x][u] * s->thumb_coef[w * 4 + u];
+			t[w][x] = (p + (1 << 11)) >> 12;
+		}
+	
+	for(y = 0; y < n; y++)
+	{
+		for(x = 0; x < n; x++)
+		{
+			p = 0;
+			for(w = 0; w < n; w++) p += idct[y][w] * t[w][x];
+			
+			p = ((p + (1 << 17)) >> 18) + 128;
+			plane[(by * n + y) * pw + bx * n + x] = p < 0 ? 0 : (p > 255 ? 255 : p);
+		}
+	}
+	
+	memset(s->thumb_coef, 0, sizeof(s->thumb_coef));
+}
+
 static char ssdv_process(ssdv_t *s)
 {
 	if(s->state == S_HUFF)
@@ -445,6 +737,7 @@ static char ssdv_process(ssdv_t *s)
 					}
 				}
 				else ssdv_out_jpeg_int(s, 0, 0);
+				ssdv_collect_dc(s);
 				
 				/* skip to the next AC part immediately */
 				s->acpart++;
@@ -531,9 +824,13 @@ static char ssdv_process(ssdv_t *s)
 					s->adc[s->component] = i;
 				}
 			}
+			ssdv_collect_dc(s);
 		}
 		else /* AC */
 		{
+			if(s->thumb && s->acpart < 64 && (zigzag[s->acpart] & 7) < s->thumb_scale && (zigzag[s->acpart] >> 3) < s->thumb_scale)
+				s->thumb_coef[(zigzag[s->acpart] >> 3) * 4 + (zigzag[s->acpart] & 7)] = ssdv_thumb_coef(i * SDQT);
+			
 			if((i = BADJ(i)))
 			{
 				s->accrle += s->acrle;
@@ -570,6 +867,8 @@ static char ssdv_process(ssdv_t *s)
 	
 	if(s->acpart >= 64)
 	{
+		if(s->thumb) ssdv_thumb_block(s);
+		
 		/* Reached the end of this MCU part */
 		if(++s->mcupart == s->ycparts + 2)
 		{
@@ -843,6 +1142,22 @@ static char ssdv_have_marker_data(ssdv_t *s)
 			return(SSDV_ERROR);
 		}
 		
+		/* Verify the thumbnail planes fit into the buffer */
+		if(s->thumb)
+		{
+			uint8_t h, v;
+			uint16_t yw, yh, cw, ch;
+			ssdv_thumb_geometry(s, &h, &v, &yw, &yh, &cw, &ch);
+			if((size_t) yw * yh + 2 * cw * ch > s->thumb_len)
+			{
+				TRACE_ERROR("SSDV > Thumbnail buffer too small (%i bytes required)", yw * yh + 2 * cw * ch);
+				s->thumb = NULL;
+			}
+		}
+		
+		/* Prepare the fast huffman lookup */
+		jpeg_dht_build_all(s);
+		
 		/* The SOS data is followed by the image data */
 		s->state = S_HUFF;
 		
@@ -1095,6 +1410,73 @@ char ssdv_enc_feed(ssdv_t *s, const uint8_t *buffer, size_t length)
 {
 	s->inp    = buffer;
 	s->in_len = length;
+	s->in_fed += length;
+	return(SSDV_OK);
+}
+
+char ssdv_enc_get_pos(ssdv_t *s, ssdv_pos_t *pos)
+{
+	/* Saves the position of the encoder between two packets, so the
+	 * packets can be encoded again from here (e.g. in a different order) */
+	pos->in_offset         = s->in_fed - s->in_len;
+	pos->in_skip           = s->in_skip;
+	pos->workbits          = s->workbits;
+	pos->worklen           = s->worklen;
+	pos->outbits           = s->outbits;
+	pos->outlen            = s->outlen;
+	pos->state             = s->state;
+	pos->marker            = s->marker;
+	pos->packet_id         = s->packet_id;
+	pos->mcu_id            = s->mcu_id;
+	pos->packet_mcu_id     = s->packet_mcu_id;
+	pos->packet_mcu_offset = s->packet_mcu_offset;
+	pos->reset_mcu         = s->reset_mcu;
+	pos->component         = s->component;
+	pos->mcupart           = s->mcupart;
+	pos->acpart            = s->acpart;
+	memcpy(pos->dc, s->dc, sizeof(pos->dc));
+	memcpy(pos->adc, s->adc, sizeof(pos->adc));
+	pos->acrle             = s->acrle;
+	pos->accrle            = s->accrle;
+	pos->needbits          = s->needbits;
+	
+	return(SSDV_OK);
+}
+
+char ssdv_enc_set_pos(ssdv_t *s, const ssdv_pos_t *pos)
+{
+	/* Returns to a position saved by ssdv_enc_get_pos. The source has to
+	 * be fed again from pos->in_offset on. Tables and image information
+	 * from the headers are kept, unless they have to be read again. */
+	if(pos->state < S_HUFF) s->stbl_len = 0;
+	
+	s->inp               = NULL;
+	s->in_len            = 0;
+	s->in_fed            = pos->in_offset;
+	s->in_skip           = pos->in_skip;
+	s->workbits          = pos->workbits;
+	s->worklen           = pos->worklen;
+	s->outbits           = pos->outbits;
+	s->outlen            = pos->outlen;
+	s->state             = pos->state;
+	s->marker            = pos->marker;
+	s->packet_id         = pos->packet_id;
+	s->mcu_id            = pos->mcu_id;
+	s->packet_mcu_id     = pos->packet_mcu_id;
+	s->packet_mcu_offset = pos->packet_mcu_offset;
+	s->reset_mcu         = pos->reset_mcu;
+	s->component         = pos->component;
+	s->mcupart           = pos->mcupart;
+	s->acpart            = pos->acpart;
+	memcpy(s->dc, pos->dc, sizeof(s->dc));
+	memcpy(s->adc, pos->adc, sizeof(s->adc));
+	s->acrle             = pos->acrle;
+	s->accrle            = pos->accrle;
+	s->needbits          = pos->needbits;
+	
+	/* Start a new packet */
+	s->out_len = 0;
+	
 	return(SSDV_OK);
 }
 
@@ -1200,6 +1582,7 @@ char ssdv_dec_init(ssdv_t *s)
 	s->sdht[0][1] = stblcpy(s, std_dht01, sizeof(std_dht01));
 	s->sdht[1][0] = stblcpy(s, std_dht10, sizeof(std_dht10));
 	s->sdht[1][1] = stblcpy(s, std_dht11, sizeof(std_dht11));
+	jpeg_dht_build_all(s);
 	
 	/* Prepare the output JPEG tables */
 	s->ddht[0][0] = dtblcpy(s, std_dht00, sizeof(std_dht00));
@@ -1232,6 +1615,15 @@ char ssdv_dec_feed(ssdv_t *s, uint8_t *packet)
 	
 	/* Read the packet header */
 	packet_id            = (packet[7] << 8) | packet[8];
+	
+	/* Packets arriving late (out of order or repeated) can't be placed in
+	 * the image anymore, the caller has to sort them by packet ID */
+	if(packet_id < s->packet_id)
+	{
+		TRACE_ERROR("SSDV > Packet %i out of order, dropped", packet_id);
+		return(SSDV_FEED_ME);
+	}
+	
 	s->packet_mcu_offset = packet[12];
 	s->packet_mcu_id     = (packet[13] << 8) | packet[14];
 	
@@ -1504,3 +1896,152 @@ void ssdv_dec_header(ssdv_packet_info_t *info, uint8_t *packet)
 
 /*****************************************************************************/
 
+char ssdv_enc_set_thumb(ssdv_t *s, uint8_t scale, uint8_t *buffer, size_t length)
+{
+	/* Collect a thumbnail of 1/8 (scale 1), 1/4 (2) or 1/2 (4) of the image
+	 * size while encoding. Must be called before the image is fed. */
+	if(scale != 1 && scale != 2 && scale != 4) return(SSDV_ERROR);
+	
+	s->thumb = buffer;
+	s->thumb_len = length;
+	s->thumb_scale = scale;
+	memset(s->thumb_coef, 0, sizeof(s->thumb_coef));
+	
+	return(SSDV_OK);
+}
+
+char ssdv_thumb_get_jpeg(ssdv_t *s, int8_t quality, uint8_t *jpeg, size_t *length)
+{
+	/* Writes the thumbnail collected while encoding as a baseline JPEG
+	 * with the standard tables and the sampling of the source image. The
+	 * encoder state is reused, so the encoder can't be used afterwards. */
+	uint8_t h, v;
+	uint16_t yw, yh, cw, ch, tw, th, mx, my, m, p;
+	int dc[3] = { 0, 0, 0 };
+	int x, y, u, w, k;
+	
+	if(!s->thumb || s->mcu_count == 0 || s->mcu_id < s->mcu_count) return(SSDV_ERROR);
+	
+	/* The dimensions have to be a multiple of 16, the edges are repeated */
+	ssdv_thumb_geometry(s, &h, &v, &yw, &yh, &cw, &ch);
+	tw = (yw + 15) & ~15;
+	th = (yh + 15) & ~15;
+	mx = tw / (8 * h);
+	my = th / (8 * v);
+	
+	/* Prepare the output like the decoder does */
+	if(quality < 0) quality = 0;
+	if(quality > 7) quality = 7;
+	s->dtbl_len = 0;
+	s->ddqt[0] = dload_standard_dqt(s, std_dqt0, quality);
+	s->ddqt[1] = dload_standard_dqt(s, std_dqt1, quality);
+	s->out = s->outp = jpeg;
+	s->out_len = *length;
+	s->outbits = 0;
+	s->outlen = 0;
+	s->out_stuff = 0;
+	s->width = tw;
+	s->height = th;
+	
+	ssdv_out_headers(s);
+	s->out_stuff = 1;
+	
+	for(m = 0; m < mx * my; m++)
+	{
+		for(p = 0; p < s->ycparts + 2; p++)
+		{
+			uint8_t *plane;
+			uint16_t pw, ph, bx, by;
+			int32_t f[8][8], t[8][8], q;
+			int rle = 0;
+			
+			if(p < s->ycparts)
+			{
+				s->component = 0;
+				plane = s->thumb;
+				pw = yw; ph = yh;
+				bx = (m % mx) * h + p % h;
+				by = (m / mx) * v + p / h;
+			}
+			else
+			{
+				s->component = p - s->ycparts + 1;
+				plane = &s->thumb[yw * yh + (s->component - 1) * cw * ch];
+				pw = cw; ph = ch;
+				bx = m % mx;
+				by = m / mx;
+			}
+			
+			/* Level shifted block, edges repeated */
+			for(y = 0; y < 8; y++)
+			{
+				uint16_t py = by * 8 + y < ph ? by * 8 + y : ph - 1;
+				for(x = 0; x < 8; x++)
+				{
+					uint16_t px = bx * 8 + x < pw ? bx * 8 + x : pw - 1;
+					f[y][x] = plane[py * pw + px] - 128;
+				}
+			}
+			
+			/* Separable FDCT, rows then columns. The rows are kept in Q5,
+			 * the coefficients are in Q20. */
+			for(y = 0; y < 8; y++)
+				for(u = 0; u < 8; u++)
+				{
+					q = 0;
+					for(x = 0; x < 8; x++) q += thumb_fdct[u][x] * f[y][x];
+					t[y][u] = (q + (1 << 9)) >> 10;
+				}
+			for(w = 0; w < 8; w++)
+				for(u = 0; u < 8; u++)
+				{
+					q = 0;
+					for(y = 0; y < 8; y++) q += thumb_fdct[w][y] * t[y][u];
+					f[w][u] = q;
+				}
+			
+			/* Quantize and write in zigzag order */
+			for(k = 0; k < 64; k++)
+			{
+				q = (int32_t) s->ddqt[s->component ? 1 : 0][1 + k] << 20;
+				int i = (f[zigzag[k] >> 3][zigzag[k] & 7] + (f[zigzag[k] >> 3][zigzag[k] & 7] < 0 ? -q : q) / 2) / q;
+				
+				s->acpart = k;
+				if(k == 0)
+				{
+					if(i > 1023) i = 1023;
+					if(i < -1024) i = -1024;
+					ssdv_out_jpeg_int(s, 0, i - dc[s->component]);
+					dc[s->component] = i;
+					continue;
+				}
+				
+				if(i > 1023) i = 1023;
+				if(i < -1023) i = -1023;
+				if(i == 0)
+				{
+					rle++;
+					continue;
+				}
+				for(; rle >= 16; rle -= 16) ssdv_out_jpeg_int(s, 15, 0);
+				ssdv_out_jpeg_int(s, rle, i);
+				rle = 0;
+			}
+			
+			/* End of block */
+			if(rle) ssdv_out_jpeg_int(s, 0, 0);
+		}
+	}
+	
+	ssdv_outbits_sync(s);
+	s->out_stuff = 0;
+	ssdv_write_marker(s, J_EOI, 0, 0);
+	
+	*length = (size_t) (s->outp - s->out);
+	s->thumb = NULL;
+	
+	return(s->out_len ? SSDV_OK : SSDV_BUFFER_FULL);
+}
+
+/*****************************************************************************/
+
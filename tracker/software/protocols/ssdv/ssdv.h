@@ -48,6 +48,17 @@ extern "C" {
 #define SSDV_TYPE_NOFEC   (0x01)
 #define SSDV_TYPE_PADDING (0x02)
 
+#define SSDV_HUFF_FAST_BITS (9) /* Code bits decoded with a single table lookup */
+
+typedef struct
+{
+	const uint8_t *fast; /* Width of the code the next SSDV_HUFF_FAST_BITS bits
+	                        start with (0 = longer code), NULL = no table */
+	int32_t maxcode[17]; /* Largest code of each width, -1 = none        */
+	int32_t delta[17];   /* Symbol index minus code for each width       */
+	const uint8_t *symbols; /* Symbols of the DHT table in code order    */
+} ssdv_huff_t;
+
 typedef struct
 {
 	/* Packet type configuration */
@@ -73,6 +84,7 @@ typedef struct
 	const uint8_t *inp;/* Pointer to next input byte                    */
 	size_t in_len;     /* Number of input bytes remaining               */
 	size_t in_skip;    /* Number of input bytes to skip                 */
+	size_t in_fed;     /* Number of input bytes fed in total            */
 	
 	/* Source bits */
 	uint32_t workbits; /* Input bits currently being worked on          */
@@ -121,14 +133,52 @@ typedef struct
 	uint8_t stbls[TBL_LEN + HBUFF_LEN];
 	uint8_t *sdht[2][2], *sdqt[2];
 	uint16_t stbl_len;
+	ssdv_huff_t shuff[2][2]; /* Lookup tables of sdht                  */
 	
 	/* The same for output */
 	uint8_t dtbls[TBL_LEN];
 	uint8_t *ddht[2][2], *ddqt[2];
 	uint16_t dtbl_len;
 	
+	/* Luminance DC statistics of the encoded blocks (block means) */
+	int32_t dc_sum;
+	uint32_t dc_sqsum;
+	uint32_t dc_count;
+	
+	/* Thumbnail pixel planes Y, Cb, Cr (encoder only, see ssdv_enc_set_thumb) */
+	uint8_t *thumb;
+	size_t thumb_len;
+	uint8_t thumb_scale;        /* Pixels per block and direction (1, 2 or 4) */
+	int32_t thumb_coef[16];     /* Dequantized low order coefficients (4x4)  */
+	
 } ssdv_t;
 
+/* Encoder position at the start of a packet (see ssdv_enc_get_pos) */
+typedef struct
+{
+	size_t   in_offset; /* Source bytes consumed, feed from here          */
+	uint8_t  in_skip;
+	uint32_t workbits;
+	uint8_t  worklen;
+	uint32_t outbits;
+	uint8_t  outlen;
+	uint8_t  state;
+	uint16_t marker;
+	uint16_t packet_id;
+	uint16_t mcu_id;
+	uint16_t packet_mcu_id;
+	uint8_t  packet_mcu_offset;
+	uint32_t reset_mcu;
+	uint8_t  component;
+	uint8_t  mcupart;
+	uint8_t  acpart;
+	int      dc[3];
+	int      adc[3];
+	uint8_t  acrle;
+	uint8_t  accrle;
+	char     needbits;
+} ssdv_pos_t;
+
 typedef struct {
 	uint8_t  type;
 	uint32_t callsign;
@@ -150,6 +200,12 @@ extern char ssdv_enc_init(ssdv_t *s, uint8_t type, char *callsign, uint8_t image
 extern char ssdv_enc_set_buffer(ssdv_t *s, uint8_t *buffer);
 extern char ssdv_enc_get_packet(ssdv_t *s);
 extern char ssdv_enc_feed(ssdv_t *s, const uint8_t *buffer, size_t length);
+extern char ssdv_enc_get_pos(ssdv_t *s, ssdv_pos_t *pos);
+extern char ssdv_enc_set_pos(ssdv_t *s, const ssdv_pos_t *pos);
+
+/* Thumbnails (DCT domain downscaling while encoding) */
+extern char ssdv_enc_set_thumb(ssdv_t *s, uint8_t scale, uint8_t *buffer, size_t length);
+extern char ssdv_thumb_get_jpeg(ssdv_t *s, int8_t quality, uint8_t *jpeg, size_t *length);
 
 /* Decoding */
 extern char ssdv_dec_init(ssdv_t *s);
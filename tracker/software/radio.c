@@ -8,131 +8,316 @@
 #include "geofence.h"
 #include "pi2c.h"
 #include "padc.h"
+#include "ax25.h"
 #include <string.h>
 
 // APRS related
 #define PLAYBACK_RATE		13200
 #define BAUD_RATE			1200									/* APRS AFSK baudrate */
-#define SAMPLES_PER_BAUD	(PLAYBACK_RATE / BAUD_RATE)				/* Samples per baud (192kHz / 1200baud = 160samp/baud) */
-#define PHASE_DELTA_1200	(((2 * 1200) << 16) / PLAYBACK_RATE)	/* Delta-phase per sample for 1200Hz tone */
-#define PHASE_DELTA_2200	(((2 * 2200) << 16) / PLAYBACK_RATE)	/* Delta-phase per sample for 2200Hz tone */
-
-static uint32_t phase_delta;			// 1200/2200 for standard AX.25
-static uint32_t phase;					// Fixed point 9.7 (2PI = TABLE_SIZE)
-static uint32_t packet_pos;				// Next bit to be sent out
-static uint32_t current_sample_in_baud;	// 1 bit = SAMPLES_PER_BAUD samples
-static uint8_t current_byte;
+#define SAMPLES_PER_BAUD	(PLAYBACK_RATE / BAUD_RATE)				/* Samples per baud (13200Hz / 1200baud = 11samp/baud) */
+#define PHASE_CYCLE			66										/* Phase units per tone cycle (smallest value both tones advance by an integer) */
+#define PHASE_DELTA_1200	(PHASE_CYCLE * 1200 / PLAYBACK_RATE)	/* Delta-phase per sample for 1200Hz tone */
+#define PHASE_DELTA_2200	(PHASE_CYCLE * 2200 / PLAYBACK_RATE)	/* Delta-phase per sample for 2200Hz tone */
+
+typedef struct {
+	uint16_t samples;		// Modulation bits of one baud (LSB first)
+	uint8_t phase;			// Phase after this baud
+} afsk_symbol_t;
+
+static afsk_symbol_t afsk_table[PHASE_CYCLE][2];	// Indexed by phase and data bit
+static bool afsk_table_init = false;
+static uint32_t phase;					// Phase in 1/PHASE_CYCLE of a tone cycle
+static uint32_t afsk_samples;			// Modulation bits not yet written into FIFO
+static uint8_t afsk_sample_cnt;			// Amount of valid bits in afsk_samples
 
 // 2FSK related
-static uint8_t txs;						// Serial maschine state
-static uint8_t txc;						// Current byte
-static uint32_t txi;					// Bitcounter of current byte
-static uint32_t txj;					// Bytecounter
+static uint32_t fsk_bits;				// UART framed bits not yet written into FIFO (LSB first)
+static uint8_t fsk_bit_cnt;				// Amount of valid bits in fsk_bits
+static uint32_t fsk_predelay;			// Predelay bits left
+
+// FIFO related
+#define FIFO_LATENCY		20			/* Time in ms the feeder may need to refill the FIFO after the threshold interrupt */
+#define FIFO_SLACK			2			/* Time in ms the threshold interrupt may be overdue before the FIFO is polled */
+#define FIFO_REFILL_MIN		32			/* FIFO bytes written per refill (minimum) */
+#define FIFO_REFILL_MAX		120			/* FIFO bytes written per refill (maximum) */
+
+static uint8_t fifo_refill;				// Bytes written per refill (FIFO threshold)
+static systime_t fifo_timeout;			// Time until the FIFO threshold must have been reached
 
 // Radio related
+typedef struct {
+	radioMSG_t	msg;					// Message (buffer is owned by the radio manager)
+	uint32_t	freq;					// Transmission frequency
+	thread_t	*owner;					// Thread which queued the message
+	eventmask_t	done_evt;				// Event signaled to owner after transmission
+	bool		queued;					// Job is waiting for the radio
+	bool		image;					// Buffer taken by getImageRadioBuffer()
+	systime_t	time;					// Time at which the job has been queued
+	systime_t	deadline;				// Max. waiting time (relative to time)
+} radio_job_t;
+
 static mutex_t radio_mtx;				// Radio mutex
 static bool nextTransmissionWaiting;	// Flag that informs the feeder thread to keep the radio switched on
-bool radio_mtx_init = false;
+static bool radio_manager_init = false;
 static mod_t active_mod = MOD_NOT_SET;
 static radioMSG_t radio_msg;
-static uint8_t radio_buffer[8192];
 static uint32_t radio_freq;
 
+static uint8_t radio_buffers[RADIO_BUFFERS][RADIO_BUFFER_SIZE] __attribute__((aligned(32)));
+static guarded_memory_pool_t radio_pool;				// Free radio buffers
+static radio_job_t radio_jobs[RADIO_BUFFERS];			// One job per radio buffer
+static semaphore_t radio_queue_sem;						// Counts queued jobs
+static semaphore_t radio_image_sem;						// Counts buffers left for image modules
+
+// Session related (messages sent back to back while the transmitter is keyed up)
+static radio_job_t *session[RADIO_BUFFERS];	// Jobs of the current session
+static uint8_t session_len;					// Amount of jobs in session
+static uint8_t session_pos;					// Next job to be fed into the FIFO
+static uint8_t *tx_data;					// Data of the job being fed
+static uint32_t tx_len;						// Length (in bits) of the job being fed
+static uint32_t packet_pos;					// Next bit to be sent out
+static ax25_stream_t tx_stream;				// Encoder of AX.25 jobs (AFSK, 2GFSK)
+
 static const char *getModulation(uint8_t key) {
 	const char *val[] = {"unknown", "OOK", "2FSK", "2GFSK", "AFSK"};
 	return val[key];
 };
 
+/**
+  * Precalculates the modulation bits of one baud for every start phase and
+  * data bit, so the FIFO feeder doesn't have to step the phase accumulator
+  * sample by sample.
+  */
+static void initAFSKTable(void)
+{
+	if(afsk_table_init)
+		return;
+
+	for(uint8_t p=0; p<PHASE_CYCLE; p++) {
+		for(uint8_t bit=0; bit<2; bit++) {
+			// Toggle tone (1200 <> 2200)
+			uint8_t delta = bit ? PHASE_DELTA_1200 : PHASE_DELTA_2200;
+			uint8_t ph = p;
+			uint16_t samples = 0;
+			for(uint8_t i=0; i<SAMPLES_PER_BAUD; i++) {
+				ph = (ph + delta) % PHASE_CYCLE;					// Add delta-phase (delta-phase tone dependent)
+				// Set modulation bit (second half of the tone cycle). A phase exactly at
+				// the half or full cycle counts to the half before, as in the former
+				// 16.16 accumulator whose truncated deltas kept it slightly behind.
+				samples |= ((ph + PHASE_CYCLE - 1) % PHASE_CYCLE >= PHASE_CYCLE/2 ? 1 : 0) << i;
+			}
+			afsk_table[p][bit].samples = samples;
+			afsk_table[p][bit].phase = ph;
+		}
+	}
+	afsk_table_init = true;
+}
+
 static void initAFSK(void) {
 	// Initialize radio
 	Si4464_Init();
 	setModemAFSK();
+	initAFSKTable();
 	active_mod = MOD_AFSK;
 }
 
-uint8_t getAFSKbyte(void)
+/**
+  * Switches the FIFO feeder to the next message of the session and sets pos
+  * to its first bit. Appended messages skip their preamble, the receiver has
+  * been synchronized by the first one already. Returns false if all messages
+  * have been fed.
+  */
+static bool nextSessionJob(uint32_t *pos)
 {
-	if(packet_pos == radio_msg.bin_len) 	// Packet transmission finished
+	if(session_pos == session_len)
 		return false;
 
-	uint8_t b = 0;
-	for(uint8_t i=0; i<8; i++)
-	{
-		if(current_sample_in_baud == 0) {
-			if((packet_pos & 7) == 0) { // Load up next byte
-				current_byte = radio_msg.buffer[packet_pos >> 3];
-			} else { // Load up next bit
-				current_byte = current_byte / 2;
-			}
+	radioMSG_t *msg = &session[session_pos]->msg;
+	tx_data = msg->buffer;
+	tx_len = msg->bin_len;
+	*pos = session_pos ? msg->preamble_len : 0;
+	if(msg->mod == MOD_AFSK || msg->mod == MOD_2GFSK) // Buffer contains AX.25 frames
+		ax25_stream_load(&tx_stream, msg->buffer, session_pos > 0);
+	session_pos++;
+	return true;
+}
+
+uint8_t getAFSKbyte(void)
+{
+	// Load bauds until one FIFO byte is complete (one baud is longer than one byte)
+	while(afsk_sample_cnt < 8) {
+		if(packet_pos == tx_len && !nextSessionJob(&packet_pos)) { // Session transmission finished
+			if(!afsk_sample_cnt)
+				return false;
+			afsk_sample_cnt = 8; // Pad last byte
+			break;
 		}
 
-		// Toggle tone (1200 <> 2200)
-		phase_delta = (current_byte & 1) ? PHASE_DELTA_1200 : PHASE_DELTA_2200;
+		uint8_t bit = ax25_stream_get(&tx_stream, 1);
+		const afsk_symbol_t *sym = &afsk_table[phase][bit];
+		afsk_samples |= (uint32_t)sym->samples << afsk_sample_cnt;
+		afsk_sample_cnt += SAMPLES_PER_BAUD;
+		phase = sym->phase;
+		packet_pos++;
+	}
 
-		phase += phase_delta;			// Add delta-phase (delta-phase tone dependent)
-		b |= ((phase >> 16) & 1) << i;	// Set modulation bit
+	uint8_t b = afsk_samples & 0xFF;
+	afsk_samples >>= 8;
+	afsk_sample_cnt -= 8;
 
-		current_sample_in_baud++;
+	return b;
+}
 
-		if(current_sample_in_baud == SAMPLES_PER_BAUD) {	// Old bit consumed, load next bit
-			current_sample_in_baud = 0;
-			packet_pos++;
+/**
+  * Returns the amount of bits of one UART frame (start bit, data bits, stop bits)
+  */
+static uint8_t getFSKFrameLen(fsk_conf_t *conf)
+{
+	return 1 + conf->bits + conf->stopbits;
+}
+
+uint8_t getFSKbyte(void)
+{
+	fsk_conf_t *conf = radio_msg.fsk_conf;
+
+	while(fsk_bit_cnt < 8) {
+		if(fsk_predelay) { // TX-delay (mark)
+			uint8_t num = fsk_predelay < 16 ? fsk_predelay : 16;
+			fsk_bits |= ((1 << num) - 1) << fsk_bit_cnt;
+			fsk_bit_cnt += num;
+			fsk_predelay -= num;
+
+		} else if(packet_pos < tx_len || nextSessionJob(&packet_pos)) { // Frame a single char
+			uint8_t c = tx_data[packet_pos >> 3];
+			packet_pos += 8;
+			uint32_t frame = (c & ((1 << conf->bits) - 1)) << 1;		// Start bit (0) and data bits
+			frame |= ((1 << conf->stopbits) - 1) << (1 + conf->bits);	// Stop bits (1)
+			fsk_bits |= frame << fsk_bit_cnt;
+			fsk_bit_cnt += getFSKFrameLen(conf);
+
+		} else { // Finished, fill last byte with mark
+			fsk_bits |= 0xFF << fsk_bit_cnt;
+			fsk_bit_cnt = 8;
 		}
 	}
 
+	uint8_t b = fsk_bits & 0xFF;
+	fsk_bits >>= 8;
+	fsk_bit_cnt -= 8;
+
 	return b;
 }
 
-uint8_t ba = HIGH;
-uint8_t getFSKbyte(void)
+uint8_t get2GFSKbyte(void)
 {
 	uint8_t b = 0;
-	for(uint8_t i=0; i<8; i++)
-	{
-		switch(txs)
-		{
-			case 6: // TX-delay
-				txj++;
-				if(txj > (uint32_t)(radio_msg.fsk_conf->predelay * radio_msg.fsk_conf->baud / 1000)) {
-					txj = 0;
-					txs = 7;
-				}
-				break;
+	for(uint8_t cnt=0; cnt<8; ) {
+		if(packet_pos == tx_len && !nextSessionJob(&packet_pos))
+			break; // Session transmission finished
+
+		uint8_t num = 8 - cnt;
+		if(num > tx_len - packet_pos)
+			num = tx_len - packet_pos; // Remainder of this message
+		b |= ax25_stream_get(&tx_stream, num) << cnt;
+		packet_pos += num;
+		cnt += num;
+	}
+	return b;
+}
 
-			case 7: // Transmit a single char
-				if(txj < radio_msg.bin_len/8) {
-					txc = radio_msg.buffer[txj]; // Select char
-					txj++;
-					ba = LOW; // Start Bit (Synchronizing)
-					txi = 0;
-					txs = 8;
-				} else { // Finished to transmit string
-					ba = HIGH;
-					return b;
-				}
-				break;
+uint8_t getRawByte(void)
+{
+	if(packet_pos >= tx_len && !nextSessionJob(&packet_pos))
+		return 0; // Session transmission finished
 
-			case 8:
-				if(txi < radio_msg.fsk_conf->bits) {
-					txi++;
-					ba = txc & 1;
-					txc = txc >> 1;
-				} else {
-					ba = HIGH; // Stop Bit
-					txi = 0;
-					txs = 9;
-				}
-				break;
+	uint8_t b = tx_data[packet_pos >> 3];
+	packet_pos += 8;
+	return b;
+}
 
-			case 9:
-				if(radio_msg.fsk_conf->stopbits == 2)
-					ba = HIGH; // Stop Bit
-				txs = 7;
-		}
-		b |= ba << i;
+/**
+  * Returns the amount of bits a message occupies in the FIFO. Messages
+  * appended to a session don't need a preamble (or predelay for 2FSK).
+  */
+static uint32_t getFIFOBits(radioMSG_t *msg, bool first)
+{
+	uint32_t start = first ? 0 : msg->preamble_len;
+
+	switch(msg->mod) {
+		case MOD_AFSK:
+			return (msg->bin_len - start) * SAMPLES_PER_BAUD;
+		case MOD_2GFSK:
+			return msg->bin_len - start;
+		case MOD_OOK:
+			return ((msg->bin_len+7)/8 - start/8) * 8;
+		case MOD_2FSK:
+			return (first ? msg->fsk_conf->predelay * msg->fsk_conf->baud / 1000 : 0) + msg->bin_len/8 * getFSKFrameLen(msg->fsk_conf);
+		default:
+			return 0;
 	}
+}
 
-	return b;
+/**
+  * Returns the amount of bytes the whole session occupies in the FIFO
+  */
+static uint16_t getSessionSize(void)
+{
+	uint32_t bits = 0;
+	for(uint8_t i=0; i<session_len; i++)
+		bits += getFIFOBits(&session[i]->msg, i == 0);
+	return (bits+7)/8;
+}
+
+/**
+  * Returns the rate (in bit/s) at which the Si4464 drains its FIFO
+  */
+static uint32_t getFIFORate(void)
+{
+	uint32_t rate = 0;
+	switch(radio_msg.mod) {
+		case MOD_AFSK:	rate = PLAYBACK_RATE;						break;
+		case MOD_2GFSK:	rate = radio_msg.gfsk_conf->speed;			break;
+		case MOD_2FSK:	rate = radio_msg.fsk_conf->baud;			break;
+		case MOD_OOK:	rate = radio_msg.ook_conf->speed * 5 / 6;	break;
+		default:														break;
+	}
+	return rate ? rate : 1;
+}
+
+/**
+  * Sets up the FIFO threshold interrupt for the active data rate. The FIFO is
+  * refilled when there is FIFO_LATENCY + FIFO_SLACK ms of data left in it,
+  * so the refill is the larger the slower the data rate is.
+  */
+static void initFIFORefill(void)
+{
+	uint32_t rate = getFIFORate();
+	uint32_t reserve = (rate * (FIFO_LATENCY + FIFO_SLACK) + 7999) / 8000 + 1; // Bytes sent during FIFO_LATENCY + FIFO_SLACK and the byte in transmission
+
+	if(reserve > SI4464_FIFO_SIZE - FIFO_REFILL_MIN)
+		reserve = SI4464_FIFO_SIZE - FIFO_REFILL_MIN;
+	fifo_refill = SI4464_FIFO_SIZE - reserve;
+	if(fifo_refill > FIFO_REFILL_MAX)
+		fifo_refill = FIFO_REFILL_MAX;
+
+	// Time to transmit a refill plus slack, the threshold must be reached until
+	// then. If not, the FIFO is polled while FIFO_LATENCY ms of data are left.
+	fifo_timeout = MS2ST((uint32_t)fifo_refill * 8000 / rate + FIFO_SLACK);
+
+	Si4464_setFIFOThreshold(fifo_refill);
+}
+
+/**
+  * Waits for the FIFO threshold interrupt and returns the amount of bytes that
+  * can be written into the FIFO.
+  */
+static uint8_t waitForFIFO(void)
+{
+	if(Si4464_waitFIFO(fifo_timeout))
+		return fifo_refill;
+
+	// Threshold not signaled in time, ask Si4464
+	return Si4464_freeFIFO();
 }
 
 static thread_t *feeder_thd = NULL;
@@ -144,16 +329,18 @@ THD_FUNCTION(si_fifo_feeder_thd2, arg)
 	chRegSetThreadName("radio_tx_feeder");
 
 	// Initialize variables for timer
-	phase_delta = PHASE_DELTA_1200;
 	phase = 0;
-	packet_pos = 0;
-	current_sample_in_baud = 0;
-	current_byte = 0;
+	session_pos = 0;
+	ax25_stream_init(&tx_stream, MOD_AFSK);
+	nextSessionJob(&packet_pos);
+	afsk_samples = 0;
+	afsk_sample_cnt = 0;
 	uint8_t localBuffer[129];
-	uint16_t c = 129;
-	uint16_t all = (radio_msg.bin_len*SAMPLES_PER_BAUD+7)/8;
+	uint16_t all = getSessionSize();
+	uint16_t c = all < 129 ? all : 129;
 
 	// Initial FIFO fill
+	initFIFORefill();
 	for(uint16_t i=0; i<c; i++)
 		localBuffer[i] = getAFSKbyte();
 	Si4464_writeFIFO(localBuffer, c);
@@ -162,19 +349,16 @@ THD_FUNCTION(si_fifo_feeder_thd2, arg)
 	radioTune(radio_freq, 0, radio_msg.power, all);
 
 	while(c < all) { // Do while bytes not written into FIFO completely
-		// Determine free memory in Si4464-FIFO
-		uint8_t more = Si4464_freeFIFO();
-		if(more > all-c) {
-			if((more = all-c) == 0) // Calculate remainder to send
-              break; // End if nothing left
-		}
+		// Wait for free memory in Si4464-FIFO
+		uint8_t more = waitForFIFO();
+		if(more > all-c)
+			more = all-c; // Calculate remainder to send
 
 		for(uint16_t i=0; i<more; i++)
 			localBuffer[i] = getAFSKbyte();
 
 		Si4464_writeFIFO(localBuffer, more); // Write into FIFO
 		c += more;
-		chThdSleepMilliseconds(15);
 	}
 	// Shutdown radio (and wait for Si4464 to finish transmission)
 	shutdownRadio();
@@ -189,15 +373,17 @@ THD_FUNCTION(si_fifo_feeder_thd3, arg)
 	chRegSetThreadName("radio_tx_feeder");
 
 	// Initialize variables for timer
-	txs = 6;
-	txc = 0;
-	txi = 0;
-	txj = 0;
+	fsk_bits = 0;
+	fsk_bit_cnt = 0;
+	fsk_predelay = radio_msg.fsk_conf->predelay * radio_msg.fsk_conf->baud / 1000;
+	session_pos = 0;
+	nextSessionJob(&packet_pos);
 	uint8_t localBuffer[129];
-	uint16_t c = 129;
-	uint16_t all = ((radio_msg.fsk_conf->predelay * radio_msg.fsk_conf->baud / 1000) + radio_msg.bin_len + radio_msg.bin_len*(radio_msg.fsk_conf->stopbits+1)/8 + 7) / 8; // FIXME: I transmit more bytes than neccessary
+	uint16_t all = getSessionSize();
+	uint16_t c = all < 129 ? all : 129;
 
 	// Initial FIFO fill
+	initFIFORefill();
 	for(uint16_t i=0; i<c; i++)
 		localBuffer[i] = getFSKbyte();
 	Si4464_writeFIFO(localBuffer, c);
@@ -206,19 +392,16 @@ THD_FUNCTION(si_fifo_feeder_thd3, arg)
 	radioTune(radio_freq, radio_msg.fsk_conf->shift, radio_msg.power, all);
 
 	while(c < all) { // Do while bytes not written into FIFO completely
-		// Determine free memory in Si4464-FIFO
-		uint8_t more = Si4464_freeFIFO();
-		if(more > all-c) {
-			if((more = all-c) == 0) // Calculate remainder to send
-              break; // End if nothing left
-		}
+		// Wait for free memory in Si4464-FIFO
+		uint8_t more = waitForFIFO();
+		if(more > all-c)
+			more = all-c; // Calculate remainder to send
 
 		for(uint16_t i=0; i<more; i++)
 			localBuffer[i] = getFSKbyte();
 
 		Si4464_writeFIFO(localBuffer, more); // Write into FIFO
 		c += more;
-		chThdSleepMilliseconds(500);
 	}
 
 	// Shutdown radio (and wait for Si4464 to finish transmission)
@@ -247,26 +430,36 @@ THD_FUNCTION(si_fifo_feeder_thd, arg)
 {
 	(void)arg;
 
-	uint16_t c = 129;
-	uint16_t all = (radio_msg.bin_len+7)/8;
-
 	chRegSetThreadName("radio_tx_feeder");
+
+	uint8_t (*getByte)(void) = radio_msg.mod == MOD_2GFSK ? get2GFSKbyte : getRawByte;
+	session_pos = 0;
+	ax25_stream_init(&tx_stream, radio_msg.mod);
+	nextSessionJob(&packet_pos);
+	uint8_t localBuffer[129];
+	uint16_t all = getSessionSize();
+	uint16_t c = all < 129 ? all : 129;
+
 	// Initial FIFO fill
-	Si4464_writeFIFO(radio_msg.buffer, c);
+	initFIFORefill();
+	for(uint16_t i=0; i<c; i++)
+		localBuffer[i] = getByte();
+	Si4464_writeFIFO(localBuffer, c);
 
 	// Start transmission
 	radioTune(radio_freq, 0, radio_msg.power, all);
 
 	while(c < all) { // Do while bytes not written into FIFO completely
-		// Determine free memory in Si4464-FIFO
-		uint8_t more = Si4464_freeFIFO();
-		if(more > all-c) {
-			if((more = all-c) == 0) // Calculate remainder to send
-              break; // End if nothing left
-		}
-		Si4464_writeFIFO(&radio_msg.buffer[c], more); // Write into FIFO
+		// Wait for free memory in Si4464-FIFO
+		uint8_t more = waitForFIFO();
+		if(more > all-c)
+			more = all-c; // Calculate remainder to send
+
+		for(uint16_t i=0; i<more; i++)
+			localBuffer[i] = getByte();
+
+		Si4464_writeFIFO(localBuffer, more); // Write into FIFO
 		c += more;
-		chThdSleepMilliseconds(15); // That value is ok up to 96k
 	}
 
 	// Shutdown radio (and wait for Si4464 to finish transmission)
@@ -388,76 +581,291 @@ uint32_t getAPRSRegionFrequency(void) {
 	return 144800000;
 }
 
+static radio_job_t* getRadioJob(uint8_t *buffer)
+{
+	return &radio_jobs[(buffer - radio_buffers[0]) / RADIO_BUFFER_SIZE];
+}
+
 /**
-  * Sends radio message into message box. This method will return false if message box is full.
+  * Returns a radio buffer (of RADIO_BUFFER_SIZE bytes) from the buffer pool.
+  * The buffer is owned by the calling thread until it is passed to
+  * transmitOnRadio() or releaseRadioBuffer(). Blocks until a buffer is free.
   */
-bool transmitOnRadio(radioMSG_t *msg, bool shutdown)
+uint8_t* getRadioBuffer(void)
 {
- 	(void)shutdown;
-	uint32_t freq = getFrequency(msg->freq); // Get transmission frequency
-	if(inRadioBand(freq)) // Frequency in radio radio band
-	{
-		if(msg->bin_len > 0) // Message length is not zero
-		{
-			lockRadio(); // Lock radio
+	uint8_t *buffer = chGuardedPoolAllocTimeout(&radio_pool, TIME_INFINITE);
+	getRadioJob(buffer)->image = false;
+	return buffer;
+}
 
-			// Copy data
-			memcpy(&radio_msg, msg, sizeof(radioMSG_t));
-			memcpy(&radio_buffer, msg->buffer, sizeof(radio_buffer));
-			radio_msg.buffer = radio_buffer;
-			radio_freq = freq;
+/**
+  * Same as getRadioBuffer() but for image modules. They get no more than
+  * RADIO_IMAGE_BUFFERS buffers at a time, so that position and log messages
+  * don't wait for a buffer while an image is transmitted.
+  */
+uint8_t* getImageRadioBuffer(void)
+{
+	chSemWait(&radio_image_sem);
+	uint8_t *buffer = chGuardedPoolAllocTimeout(&radio_pool, TIME_INFINITE);
+	getRadioJob(buffer)->image = true;
+	return buffer;
+}
 
-			TRACE_INFO(	"RAD  > Transmit %d.%03d MHz, Pwr %d, %s, %d bits",
-						freq/1000000, (freq%1000000)/1000, msg->power,
-						getModulation(msg->mod), msg->bin_len
-			);
-		
-			switch(msg->mod)
-			{
-				case MOD_2FSK:
-					if(active_mod != msg->mod)
-						init2FSK();
-					send2FSK();
-					break;
-				case MOD_2GFSK:
-					if(active_mod != msg->mod)
-						init2GFSK();
-					send2GFSK();
-					break;
-				case MOD_AFSK:
-					if(active_mod != msg->mod)
-						initAFSK();
-					sendAFSK();
-					break;
-				case MOD_OOK:
-					if(active_mod != msg->mod)
-						initOOK();
-					sendOOK();
-					break;
-				case MOD_NOT_SET:
-					TRACE_ERROR("RAD  > Modulation not set");
-					break;
-			}
+/**
+  * Returns an unused radio buffer into the buffer pool.
+  */
+void releaseRadioBuffer(uint8_t *buffer)
+{
+	bool image = getRadioJob(buffer)->image;
+	chGuardedPoolFree(&radio_pool, buffer);
+	if(image)
+		chSemSignal(&radio_image_sem);
+}
 
-			unlockRadio(); // Unlock radio
+/**
+  * Queues a message for transmission and returns immediately. msg->buffer must
+  * have been taken from getRadioBuffer(), its ownership passes to the radio
+  * manager which returns it into the pool after transmission. The calling
+  * thread is signaled done_evt once the message has been sent (or dropped).
+  * Pass 0 if no signal is needed. Returns false if the message was dropped.
+  */
+bool transmitOnRadio(radioMSG_t *msg, eventmask_t done_evt)
+{
+	radio_job_t *job = getRadioJob(msg->buffer);
+	memcpy(&job->msg, msg, sizeof(radioMSG_t));
+	job->freq = getFrequency(msg->freq); // Get transmission frequency
+	job->owner = chThdGetSelfX();
+	job->done_evt = done_evt;
+	Si4464_addSynthFrequency(job->freq); // Calculate synthesizer settings before the radio needs them
 
-		} else {
+	if(!inRadioBand(job->freq)) { // Frequency out of radio band
+
+		TRACE_ERROR("RAD  > Radio cant transmit on this frequency, %d.%03d MHz, Pwr %d dBm, %s, %d bits",
+					job->freq/1000000, (job->freq%1000000)/1000, msg->power, getModulation(msg->mod), msg->bin_len
+		);
 
-			TRACE_ERROR("RAD  > It is nonsense to transmit 0 bits, %d.%03d MHz, Pwr dBm, %s, %d bits",
-						freq/1000000, (freq%1000000)/1000, msg->power, getModulation(msg->mod), msg->bin_len
+	} else if(msg->bin_len == 0) { // Message length is zero
+
+		TRACE_ERROR("RAD  > It is nonsense to transmit 0 bits, %d.%03d MHz, Pwr %d dBm, %s, %d bits",
+					job->freq/1000000, (job->freq%1000000)/1000, msg->power, getModulation(msg->mod), msg->bin_len
+		);
+
+	} else {
+
+		chSysLock();
+		job->time = chVTGetSystemTimeX();
+		job->deadline = (systime_t)((uint64_t)msg->deadline * CH_CFG_ST_FREQUENCY / 1000); // MS2ST() overflows above 429 s
+		job->queued = true;
+		nextTransmissionWaiting = true;
+		chSemSignalI(&radio_queue_sem);
+		chSchRescheduleS();
+		chSysUnlock();
+		return true;
+
+	}
+
+	// Drop message
+	releaseRadioBuffer(job->msg.buffer);
+	if(done_evt)
+		chEvtSignal(job->owner, done_evt);
+	return false;
+}
+
+/**
+  * Returns true if job a has to be transmitted before job b. Jobs which have
+  * exceeded their deadline go first, then jobs of higher priority. Jobs of
+  * same priority are transmitted earliest deadline first.
+  */
+static bool isJobPreferred(radio_job_t *a, radio_job_t *b, systime_t now)
+{
+	systime_t wait_a = now - a->time;
+	systime_t wait_b = now - b->time;
+	bool late_a = wait_a >= a->deadline;
+	bool late_b = wait_b >= b->deadline;
+
+	if(late_a != late_b)
+		return late_a;
+	if(a->msg.priority != b->msg.priority)
+		return a->msg.priority > b->msg.priority;
+	return (int32_t)(a->deadline - wait_a) < (int32_t)(b->deadline - wait_b);
+}
+
+/**
+  * Returns true if the job can be appended to a transmission of msg on freq
+  * without reconfiguring the radio.
+  */
+static bool isJobAppendable(radio_job_t *job, radioMSG_t *msg, uint32_t freq)
+{
+	if(job->msg.mod != msg->mod || job->freq != freq || job->msg.power != msg->power)
+		return false;
+
+	switch(msg->mod) {
+		case MOD_2GFSK:
+			return job->msg.gfsk_conf->speed == msg->gfsk_conf->speed;
+		case MOD_2FSK:
+			return job->msg.fsk_conf->baud == msg->fsk_conf->baud
+				&& job->msg.fsk_conf->shift == msg->fsk_conf->shift
+				&& job->msg.fsk_conf->bits == msg->fsk_conf->bits
+				&& job->msg.fsk_conf->stopbits == msg->fsk_conf->stopbits;
+		case MOD_OOK:
+			return job->msg.ook_conf->speed == msg->ook_conf->speed;
+		default:
+			return true;
+	}
+}
+
+/**
+  * Returns the queued job which has to be transmitted next. If msg is not
+  * NULL, only jobs which can be appended to msg are taken into account.
+  * Must be called from a locked state.
+  */
+static radio_job_t* selectJobS(radioMSG_t *msg, uint32_t freq)
+{
+	systime_t now = chVTGetSystemTimeX();
+	radio_job_t *best = NULL;
+
+	for(uint8_t i=0; i<RADIO_BUFFERS; i++) {
+		radio_job_t *job = &radio_jobs[i];
+		if(!job->queued || (msg != NULL && !isJobAppendable(job, msg, freq)))
+			continue;
+		if(best == NULL || isJobPreferred(job, best, now))
+			best = job;
+	}
+	return best;
+}
+
+/**
+  * Takes the next job from the queue and appends all queued jobs of the same
+  * modulation, frequency and power to the session, so they are transmitted
+  * back to back without reinitializing the radio.
+  */
+static void buildSession(void)
+{
+	chSemWait(&radio_queue_sem);
+
+	chSysLock();
+	radio_job_t *job = selectJobS(NULL, 0);
+	job->queued = false;
+	session[0] = job;
+	session_len = 1;
+	uint32_t bits = getFIFOBits(&job->msg, true);
+
+	while((job = selectJobS(&session[0]->msg, session[0]->freq)) != NULL) {
+		uint32_t more = getFIFOBits(&job->msg, false);
+		if((bits + more + 7) / 8 > SI4464_MAX_TX_LEN)
+			break; // Session would exceed max. transmission length
+		job->queued = false;
+		chSemFastWaitI(&radio_queue_sem);
+		session[session_len++] = job;
+		bits += more;
+	}
+	chSysUnlock();
+}
+
+/**
+  * Radio manager. Transmits the queued messages by priority and deadline.
+  * Messages which share modulation and frequency are transmitted in one
+  * session. The next message can be encoded while the current one is on air.
+  */
+THD_FUNCTION(moduleRADIO, arg)
+{
+	(void)arg;
+
+	while(true)
+	{
+		buildSession();
+
+		lockRadio(); // Lock radio
+
+		chSysLock();
+		nextTransmissionWaiting = chSemGetCounterI(&radio_queue_sem) > 0;
+		chSysUnlock();
+
+		memcpy(&radio_msg, &session[0]->msg, sizeof(radioMSG_t));
+		radio_freq = session[0]->freq;
+
+		for(uint8_t i=0; i<session_len; i++) {
+			TRACE_INFO(	"RAD  > Transmit %d.%03d MHz, Pwr %d, %s, %d bits%s",
+						radio_freq/1000000, (radio_freq%1000000)/1000, radio_msg.power,
+						getModulation(radio_msg.mod), session[i]->msg.bin_len,
+						i ? " (appended)" : ""
 			);
+		}
 
+		uint32_t spi_count = Si4464_getSPICount();
+		feeder_thd = NULL;
+		switch(radio_msg.mod)
+		{
+			case MOD_2FSK:
+				if(active_mod != radio_msg.mod)
+					init2FSK();
+				send2FSK();
+				break;
+			case MOD_2GFSK:
+				if(active_mod != radio_msg.mod)
+					init2GFSK();
+				send2GFSK();
+				break;
+			case MOD_AFSK:
+				if(active_mod != radio_msg.mod)
+					initAFSK();
+				sendAFSK();
+				break;
+			case MOD_OOK:
+				if(active_mod != radio_msg.mod)
+					initOOK();
+				sendOOK();
+				break;
+			case MOD_NOT_SET:
+				TRACE_ERROR("RAD  > Modulation not set");
+				break;
 		}
 
-	} else { // Frequency out of radio band
+		// Wait for feeder thread to terminate
+		if(feeder_thd != NULL)
+			chThdWait(feeder_thd);
+		TRACE_INFO("RAD  > Transmission used %d SPI transactions", Si4464_getSPICount() - spi_count);
 
-		TRACE_ERROR("RAD  > Radio cant transmit on this frequency, %d.%03d MHz, Pwr dBm, %s, %d bits",
-					freq/1000000, (freq%1000000)/1000, msg->power, getModulation(msg->mod), msg->bin_len
-		);
+		unlockRadio(); // Unlock radio
 
+		// Return buffers and inform owners
+		for(uint8_t i=0; i<session_len; i++) {
+			radio_job_t *job = session[i];
+			releaseRadioBuffer(job->msg.buffer);
+			if(job->done_evt)
+				chEvtSignal(job->owner, job->done_evt);
+		}
 	}
+}
 
-	return true;
+/**
+  * Initializes the radio buffer pool and starts the radio manager
+  */
+void initRadioManager(void)
+{
+	if(radio_manager_init)
+		return;
+
+	chMtxObjectInit(&radio_mtx);
+	chGuardedPoolObjectInit(&radio_pool, RADIO_BUFFER_SIZE);
+	chGuardedPoolLoadArray(&radio_pool, radio_buffers, RADIO_BUFFERS);
+	chSemObjectInit(&radio_queue_sem, 0);
+	chSemObjectInit(&radio_image_sem, RADIO_IMAGE_BUFFERS);
+	radio_manager_init = true;
+
+	// Precalculate synthesizer settings for the APRS region frequencies
+	const uint32_t aprs_freq[] = {
+		APRS_FREQ_OTHER, APRS_FREQ_AMERICA, APRS_FREQ_CHINA, APRS_FREQ_JAPAN, APRS_FREQ_SOUTHKOREA,
+		APRS_FREQ_SOUTHEASTASIA, APRS_FREQ_AUSTRALIA, APRS_FREQ_NEWZEALAND, APRS_FREQ_ARGENTINA, APRS_FREQ_BRAZIL
+	};
+	for(uint8_t i=0; i<sizeof(aprs_freq)/sizeof(aprs_freq[0]); i++)
+		Si4464_addSynthFrequency(aprs_freq[i]);
+
+	TRACE_INFO("RAD  > Startup radio manager");
+	thread_t *th = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(1024), "RAD", HIGHPRIO, moduleRADIO, NULL);
+	if(!th) {
+		TRACE_ERROR("RAD  > Could not startup thread (not enough memory available)");
+	}
 }
 
 uint32_t getFrequency(freq_conf_t *config)
@@ -479,38 +887,19 @@ uint32_t getFrequency(freq_conf_t *config)
 
 void lockRadio(void)
 {
-	// Initialize mutex
-	if(!radio_mtx_init)
-		chMtxObjectInit(&radio_mtx);
-	radio_mtx_init = true;
-
 	chMtxLock(&radio_mtx);
-	nextTransmissionWaiting = true;
-
-	// Wait for old feeder thread to terminate
-	if(feeder_thd != NULL) // No waiting on first use
-		chThdWait(feeder_thd);
 }
 
-/* This method is only called by image.c. It's not different to lockRadio() with
- * the exception that the radio it shutdown after transmission (if there is any) */
+/* This method is only called by the camera driver (ov5640.c). It waits until the radio manager has
+ * finished the current transmission and keeps it from starting a new one until
+ * unlockRadio() is called. The radio is shutdown after the transmission unless
+ * there is another message queued. */
 void lockRadioByCamera(void)
 {
-	// Initialize mutex
-	if(!radio_mtx_init)
-		chMtxObjectInit(&radio_mtx);
-	radio_mtx_init = true;
-
 	chMtxLock(&radio_mtx);
-
-	// Wait for old feeder thread to terminate
-	if(feeder_thd != NULL) // No waiting on first use
-		chThdWait(feeder_thd);
 }
 
 void unlockRadio(void)
 {
-	nextTransmissionWaiting = false;
 	chMtxUnlock(&radio_mtx);
 }
-
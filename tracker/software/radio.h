@@ -19,7 +19,24 @@
 #define APRS_FREQ_ARGENTINA			144930000
 #define APRS_FREQ_BRAZIL			145575000
 
-bool transmitOnRadio(radioMSG_t *msg, bool shutdown);
+#define RADIO_BUFFER_SIZE			8192		/* Size of one radio buffer in bytes */
+#define RADIO_BUFFERS				3			/* One buffer on air while the next one is encoded, one reserved */
+#define RADIO_IMAGE_BUFFERS			2			/* Buffers usable by image modules (the others are kept for position and log) */
+#define RADIO_MAX_TX_BITS(mod)		((mod) == MOD_AFSK ? SI4464_MAX_TX_LEN * 8 / 11 : SI4464_MAX_TX_LEN * 8) /* Max. bits of one transmission (AFSK takes 11 FIFO bits per bit) */
+
+// Default scheduling of the modules (if not set in config)
+#define RADIO_PRIO_POSITION			3
+#define RADIO_PRIO_LOG				2
+#define RADIO_PRIO_IMAGE			1
+#define RADIO_DEADLINE_POSITION		10000		/* Max. waiting time in ms */
+#define RADIO_DEADLINE_LOG			60000
+#define RADIO_DEADLINE_IMAGE		600000
+
+void initRadioManager(void);
+uint8_t* getRadioBuffer(void);
+uint8_t* getImageRadioBuffer(void);
+void releaseRadioBuffer(uint8_t *buffer);
+bool transmitOnRadio(radioMSG_t *msg, eventmask_t done_evt);
 void shutdownRadio(void);
 uint32_t getFrequency(freq_conf_t *config);
 void lockRadio(void);
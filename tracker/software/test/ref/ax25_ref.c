@@ -0,0 +1,34 @@
+/* AX.25 encoder of the baseline (base/aprs/ax25.[ch] are extracted from git
+ * by the Makefile). The functions are renamed, so they can be linked next to
+ * the current ones. */
+#define ax25_init			ref_ax25_init
+#define ax25_send_header	ref_ax25_send_header
+#define ax25_send_path		ref_ax25_send_path
+#define ax25_send_byte		ref_ax25_send_byte
+#define ax25_send_string	ref_ax25_send_string
+#define ax25_send_footer	ref_ax25_send_footer
+#define ax25_send_sync		ref_ax25_send_sync
+#define ax25_send_flag		ref_ax25_send_flag
+#define scramble			ref_ax25_scramble
+#define scramble_bit		ref_ax25_scramble_bit
+#define nrzi_encode			ref_ax25_nrzi_encode
+#define lfsr				ref_ax25_lfsr
+
+#include "ax25.c"
+#include "ref.h"
+
+uint32_t ref_ax25_frame(uint8_t *bits, uint16_t max_size, mod_t mod, const char *callsign, uint8_t ssid,
+	const char *path, uint16_t preamble, const uint8_t *info, uint16_t len)
+{
+	ax25_t packet;
+	packet.data = bits;
+	packet.max_size = max_size;
+	packet.mod = mod;
+
+	ax25_init(&packet);
+	ax25_send_header(&packet, callsign, ssid, path, preamble);
+	for(uint16_t i = 0; i < len; i++)
+		ax25_send_byte(&packet, info[i]);
+	ax25_send_footer(&packet);
+	return packet.size;
+}
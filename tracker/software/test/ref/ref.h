@@ -0,0 +1,24 @@
+#ifndef __REF_H__
+#define __REF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ch.h"
+#include "types.h"
+
+/* Reference implementations (baseline versions of the firmware code) */
+void ref_encode_rs_8(uint8_t *data, uint8_t *parity, int pad);
+int ref_decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad);
+
+/* Encodes one frame with the baseline AX.25 encoder: Preamble, sync flags,
+ * the bit stuffed frame with FCS and the end of frame flag (not scrambled, no
+ * NRZI). Returns its size in bits. */
+uint32_t ref_ax25_frame(uint8_t *bits, uint16_t max_size, mod_t mod, const char *callsign, uint8_t ssid,
+	const char *path, uint16_t preamble, const uint8_t *info, uint16_t len);
+
+/* See ssdv_run.h */
+int ref_ssdv_encode(const uint8_t *jpeg, size_t len, uint8_t type, int8_t quality, uint8_t *pkts, int max);
+size_t ref_ssdv_decode(uint8_t *pkts, int n, uint8_t *jpeg, size_t max);
+
+#endif
+
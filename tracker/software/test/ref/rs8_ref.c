@@ -0,0 +1,7 @@
+/* Reed-Solomon coder of the baseline (base/ssdv/rs8.c is extracted from git
+ * by the Makefile). The functions are renamed, so they can be linked next to
+ * the current ones. */
+#define encode_rs_8			ref_encode_rs_8
+#define decode_rs_8			ref_decode_rs_8
+
+#include "rs8.c"
@@ -0,0 +1,20 @@
+/* SSDV coder of the baseline (base/ssdv/ssdv.[ch] are extracted from git by
+ * the Makefile). It uses the Reed-Solomon coder of the baseline too. */
+#define REF(name) ref_##name
+#include "ssdv_rename.h"
+#define encode_rs_8			ref_encode_rs_8
+#define decode_rs_8			ref_decode_rs_8
+
+#include "ssdv.c"
+#include "../ssdv_run.h"
+#include "ref.h"
+
+int ref_ssdv_encode(const uint8_t *jpeg, size_t len, uint8_t type, int8_t quality, uint8_t *pkts, int max)
+{
+	return ssdv_run_encode(jpeg, len, type, quality, pkts, max);
+}
+
+size_t ref_ssdv_decode(uint8_t *pkts, int n, uint8_t *jpeg, size_t max)
+{
+	return ssdv_run_decode(pkts, n, jpeg, max);
+}
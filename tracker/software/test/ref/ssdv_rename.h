@@ -0,0 +1,13 @@
+/* Renames the SSDV functions of a reference version with REF(name), so that
+ * it can be linked next to the current one */
+#define ssdv_enc_init		REF(ssdv_enc_init)
+#define ssdv_enc_set_buffer	REF(ssdv_enc_set_buffer)
+#define ssdv_enc_get_packet	REF(ssdv_enc_get_packet)
+#define ssdv_enc_feed		REF(ssdv_enc_feed)
+#define ssdv_dec_init		REF(ssdv_dec_init)
+#define ssdv_dec_set_buffer	REF(ssdv_dec_set_buffer)
+#define ssdv_dec_feed		REF(ssdv_dec_feed)
+#define ssdv_dec_get_jpeg	REF(ssdv_dec_get_jpeg)
+#define ssdv_dec_is_packet	REF(ssdv_dec_is_packet)
+#define ssdv_dec_header		REF(ssdv_dec_header)
+#define jpeg_marker_t		REF(jpeg_marker_t)
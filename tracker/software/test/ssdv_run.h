@@ -0,0 +1,57 @@
+#ifndef __SSDV_RUN_H__
+#define __SSDV_RUN_H__
+
+/* Encodes and decodes a whole image with the ssdv.h in scope. It's included
+ * by the tests and by the reference implementations (ref/ssdv_ref.c). */
+
+#include <string.h>
+
+#define SSDV_RUN_FEED	128 /* Bytes fed per call, like the image thread */
+
+/* Encodes a JPEG into packets, returns the number of packets or -1 */
+static int ssdv_run_encode(const uint8_t *jpeg, size_t len, uint8_t type, int8_t quality, uint8_t *pkts, int max)
+{
+	ssdv_t s;
+	size_t fed = 0;
+	int n = 0;
+	char c;
+
+	ssdv_enc_init(&s, type, "DL7AD", 1, quality);
+	while(n < max)
+	{
+		ssdv_enc_set_buffer(&s, &pkts[n * SSDV_PKT_SIZE]);
+		while((c = ssdv_enc_get_packet(&s)) == SSDV_FEED_ME)
+		{
+			size_t r = len - fed < SSDV_RUN_FEED ? len - fed : SSDV_RUN_FEED;
+			if(!r)
+				return -1;
+			ssdv_enc_feed(&s, &jpeg[fed], r);
+			fed += r;
+		}
+		if(c == SSDV_EOI)
+			return n;
+		if(c != SSDV_OK)
+			return -1;
+		n++;
+	}
+	return -1;
+}
+
+/* Decodes packets into a JPEG, returns its length or 0 */
+static size_t ssdv_run_decode(uint8_t *pkts, int n, uint8_t *jpeg, size_t max)
+{
+	ssdv_t s;
+	uint8_t *out;
+	size_t len = 0;
+
+	ssdv_dec_init(&s);
+	ssdv_dec_set_buffer(&s, jpeg, max);
+	for(int i = 0; i < n; i++)
+		ssdv_dec_feed(&s, &pkts[i * SSDV_PKT_SIZE]);
+	if(ssdv_dec_get_jpeg(&s, &out, &len) != SSDV_OK)
+		return 0;
+	return len;
+}
+
+#endif
+
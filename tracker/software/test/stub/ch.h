@@ -0,0 +1,81 @@
+#ifndef __CH_H__
+#define __CH_H__
+
+/*
+ * Host builds of the portable code don't use the RTOS. The types are
+ * placeholders and the kernel calls do nothing, except for the time functions
+ * which are provided by the tests that need them (simulated time).
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TRUE  true
+#define FALSE false
+
+#define CH_CFG_ST_FREQUENCY	10000	/* chconf.h */
+
+typedef uint32_t systime_t;
+typedef uint32_t eventmask_t;
+typedef int32_t msg_t;
+typedef int32_t tprio_t;
+typedef struct { int dummy; } thread_t;
+typedef struct { int dummy; } mutex_t;
+typedef struct { int dummy; } semaphore_t;
+typedef struct { int dummy; } binary_semaphore_t;
+typedef struct { int dummy; } guarded_memory_pool_t;
+
+#define MSG_OK			0
+#define MSG_TIMEOUT		-1
+#define HIGHPRIO		255
+#define NORMALPRIO		128
+#define LOWPRIO			2
+#define TIME_IMMEDIATE	((systime_t)0)
+#define TIME_INFINITE	((systime_t)-1)
+
+#define S2ST(sec)	((systime_t)((uint32_t)(sec) * (uint32_t)CH_CFG_ST_FREQUENCY))
+#define MS2ST(msec)	((systime_t)((((uint32_t)(msec)) * ((uint32_t)CH_CFG_ST_FREQUENCY) + 999UL) / 1000UL))
+#define ST2MS(n)	(((n) * 1000UL + CH_CFG_ST_FREQUENCY - 1UL) / CH_CFG_ST_FREQUENCY)
+
+#define THD_WORKING_AREA_SIZE(n)	(n)
+#define THD_WORKING_AREA(s, n)		uint8_t s[THD_WORKING_AREA_SIZE(n)]
+#define THD_FUNCTION(tname, arg)	void tname(void *arg)
+typedef void (*tfunc_t)(void *p);
+
+/* Simulated time (see the tests) */
+systime_t chVTGetSystemTimeX(void);
+void chThdSleepMilliseconds(uint32_t msec);
+
+static inline systime_t chVTGetSystemTime(void) { return chVTGetSystemTimeX(); }
+
+static inline void chSysLock(void) {}
+static inline void chSysUnlock(void) {}
+static inline void chSchRescheduleS(void) {}
+
+static inline thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, tfunc_t pf, void *arg) { return NULL; }
+static inline thread_t *chThdCreateFromHeap(void *heapp, size_t size, const char *name, tprio_t prio, tfunc_t pf, void *arg) { return NULL; }
+static inline thread_t *chThdGetSelfX(void) { return NULL; }
+static inline msg_t chThdWait(thread_t *tp) { return MSG_OK; }
+static inline void chThdExit(msg_t msg) {}
+static inline void chRegSetThreadName(const char *name) {}
+
+static inline void chMtxObjectInit(mutex_t *mp) {}
+static inline void chMtxLock(mutex_t *mp) {}
+static inline void chMtxUnlock(mutex_t *mp) {}
+
+static inline void chSemObjectInit(semaphore_t *sp, int32_t n) {}
+static inline msg_t chSemWait(semaphore_t *sp) { return MSG_OK; }
+static inline void chSemSignal(semaphore_t *sp) {}
+static inline void chSemSignalI(semaphore_t *sp) {}
+static inline void chSemFastWaitI(semaphore_t *sp) {}
+static inline int32_t chSemGetCounterI(semaphore_t *sp) { return 0; }
+
+static inline void chGuardedPoolObjectInit(guarded_memory_pool_t *gmp, size_t size) {}
+static inline void chGuardedPoolLoadArray(guarded_memory_pool_t *gmp, void *p, size_t n) {}
+static inline void *chGuardedPoolAllocTimeout(guarded_memory_pool_t *gmp, systime_t timeout) { return NULL; }
+static inline void chGuardedPoolFree(guarded_memory_pool_t *gmp, void *objp) {}
+
+static inline void chEvtSignal(thread_t *tp, eventmask_t events) {}
+
+#endif
+
@@ -0,0 +1,18 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdio.h>
+
+/* Host builds don't trace, the arguments are only type-checked */
+#define TRACE_NONE(format, args...)  do { if(0) printf(format, ##args); } while(0)
+#define TRACE_DEBUG(format, args...) TRACE_NONE(format, ##args)
+#define TRACE_INFO(format, args...)  TRACE_NONE(format, ##args)
+#define TRACE_WARN(format, args...)  TRACE_NONE(format, ##args)
+#define TRACE_ERROR(format, args...) TRACE_NONE(format, ##args)
+#define TRACE_USB(format, args...)   TRACE_NONE(format, ##args)
+#define TRACE_BIN(data, len)         do { (void)(data); (void)(len); } while(0)
+#define TRACE_BIN_CHAR(data, len)    do { (void)(data); (void)(len); } while(0)
+#define TRACE_TAB ""
+
+#endif
+
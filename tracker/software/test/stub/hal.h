@@ -0,0 +1,11 @@
+#ifndef __HAL_H__
+#define __HAL_H__
+
+#include "ch.h"
+
+/* board/board.h */
+#define RADIO_MIN_FREQ	144000000
+#define RADIO_MAX_FREQ	148000000
+
+#endif
+
@@ -0,0 +1,391 @@
+/* AX.25 encoder (protocols/aprs/ax25.c) against the baseline encoder
+ * (ref/ax25_ref.c) and bitwise versions of the baseline scrambler and NRZI
+ * encoder. FX.25 blocks are built from the frames of the baseline encoder. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ax25.h"
+#include "rs8.h"
+#include "ref/ref.h"
+
+#define PACKETS		2000
+#define BUFFER_SIZE	8192	/* RADIO_BUFFER_SIZE */
+#define MAX_BITS	(BUFFER_SIZE * 8 * 2)
+
+/* Scrambler of the baseline (one bit per step, newest bit in bit 0) */
+static uint32_t ref_lfsr;
+static uint8_t ref_scramble_bit(uint8_t in)
+{
+	uint8_t x = (in ^ (ref_lfsr >> 16) ^ (ref_lfsr >> 11)) & 1;
+	ref_lfsr = (ref_lfsr << 1) | x;
+	return x;
+}
+
+/* NRZI encoder of the baseline (a zero changes the tone) */
+static uint8_t ref_tone;
+static uint8_t ref_nrzi_bit(uint8_t in)
+{
+	if(!in)
+		ref_tone = !ref_tone;
+	return ref_tone;
+}
+
+/* The stream keeps the last 17 scrambled bits with the oldest in bit 0 */
+static uint32_t reverse17(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+	x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+	x = (x >> 16) | (x << 16);
+	return (x >> 15) & 0x1FFFF;
+}
+
+/**
+ * Scrambles and NRZI encodes every input of 1-8 bits from every scrambler
+ * and tone state with ax25_stream_get() and the bitwise reference. The input
+ * bits are preloaded into the stream, so it doesn't need a packet.
+ */
+static int test_scrambler(void)
+{
+	int fails = 0;
+
+	for(int scramble = 0; scramble <= 1; scramble++)
+	for(uint32_t state = 0; state < (scramble ? 1 << 17 : 1); state++)
+	for(uint8_t tone = 0; tone <= 1; tone++)
+	for(uint8_t num = 1; num <= 8; num++)
+	for(uint32_t in = 0; in < 1u << num; in++)
+	{
+		ax25_stream_t stream;
+		ax25_stream_init(&stream, scramble ? MOD_2GFSK : MOD_AFSK);
+		stream.bits = in;
+		stream.bit_cnt = num;
+		stream.lfsr = reverse17(state);
+		stream.tone = tone;
+		uint8_t out = ax25_stream_get(&stream, num);
+
+		uint8_t ref = 0;
+		ref_lfsr = state;
+		ref_tone = tone;
+		for(uint8_t i = 0; i < num; i++)
+		{
+			uint8_t bit = (in >> i) & 1;
+			if(scramble)
+				bit = ref_scramble_bit(bit);
+			ref |= ref_nrzi_bit(bit) << i;
+		}
+
+		if(out != ref || stream.tone != ref_tone
+		|| (scramble && stream.lfsr != reverse17(ref_lfsr & 0x1FFFF)))
+		{
+			if(fails++ < 10)
+				printf("scrambler: state %05X, tone %d, %d bits %02X: %02X, reference %02X\n",
+					state, tone, num, in, out, ref);
+		}
+	}
+
+	printf("scrambler/NRZI: %s\n", fails ? "FAIL" : "ok");
+	return fails;
+}
+
+static uint32_t seed = 0x12345678;
+static uint32_t rnd(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/* Reference transmission */
+static uint8_t ref_bits[MAX_BITS / 8];
+static uint32_t ref_len;
+
+static void ref_put(uint8_t bit)
+{
+	if(bit)
+		ref_bits[ref_len >> 3] |= 1 << (ref_len & 7);
+	else
+		ref_bits[ref_len >> 3] &= ~(1 << (ref_len & 7));
+	ref_len++;
+}
+
+static void ref_put_byte(uint8_t byte)
+{
+	for(uint8_t i = 0; i < 8; i++)
+		ref_put((byte >> i) & 1);
+}
+
+static uint8_t get_bit(const uint8_t *bits, uint32_t i)
+{
+	return (bits[i >> 3] >> (i & 7)) & 1;
+}
+
+/* FX.25 codes of the specification: Correlation tag, block and data size */
+static const struct {
+	uint64_t tag;
+	uint8_t n;
+	uint8_t k;
+} fx25_codes[] = {
+	{0xB74DB7DF8A532F3E, 255, 239},
+	{0x26FF60A600CC8FDE, 144, 128},
+	{0xC7DC0508F3D9B09E,  80,  64},
+	{0x8F056EB4369660EE,  48,  32},
+	{0x6E260B1AC5835FAE, 255, 223},
+	{0xFF94DC634F1CFF4E, 160, 128},
+	{0x1EB7B9CDBC09C00E,  96,  64},
+	{0xDBF869BD2DBB1776,  64,  32},
+	{0x3ADB0C13DEAE2836, 255, 191},
+	{0xAB69DB6A543188D6, 192, 128},
+	{0x4A4ABEC4A724B796, 128,  64},
+};
+
+/* Smallest FX.25 code with nroots check bytes for an HDLC frame of len bits */
+static int fx25_code(uint32_t len, uint8_t nroots)
+{
+	int best = -1;
+	for(int i = 0; i < (int)(sizeof(fx25_codes) / sizeof(fx25_codes[0])); i++)
+		if(fx25_codes[i].n - fx25_codes[i].k == nroots && fx25_codes[i].k * 8 >= len
+		&& (best < 0 || fx25_codes[i].k < fx25_codes[best].k))
+			best = i;
+	return best;
+}
+
+/* Inputs of a frame and the bits the encoder added for it (0: dropped) */
+typedef struct {
+	uint8_t ssid;
+	const char *path;
+	uint16_t preamble;
+	uint8_t fx25;
+	uint16_t len;
+	uint8_t info[256];
+	uint32_t size;
+} frame_t;
+
+typedef struct {
+	ax25_t ax25;
+	bool full;			// Buffer of BUFFER_SIZE (no frame is dropped or kept as AX.25)
+	uint8_t frames;
+	frame_t frame[6];
+} packet_t;
+
+/**
+ * Appends a frame to the reference. It's encoded by the baseline encoder:
+ * Preamble, 4 sync flags, the bit stuffed frame with FCS and the end of frame
+ * flag. For FX.25 the frame from the last sync flag on is padded with flags
+ * to the data block of the smallest code, the block is sent behind the sync
+ * flags, the correlation tag and followed by the check bytes. The encoder may
+ * keep the frame as AX.25 if its buffer is too small for the block. Returns
+ * false if the frame size differs from the reference.
+ */
+static bool ref_frame(const frame_t *f, mod_t mod, bool full, bool skip_preamble)
+{
+	static uint8_t bits[BUFFER_SIZE];
+	uint32_t size = ref_ax25_frame(bits, sizeof(bits), mod, "DL7AD", f->ssid, f->path, f->preamble, f->info, f->len);
+	uint32_t len = ref_ax25_frame(bits, sizeof(bits), mod, "DL7AD", f->ssid, f->path, 0, f->info, f->len);
+	uint32_t preamble = size - len;
+
+	int c = f->fx25 ? fx25_code(len - 24, f->fx25) : -1;
+	uint32_t fx25_size = c < 0 ? 0 : preamble + 32 + (8 + fx25_codes[c].n) * 8;
+	if(c >= 0 && (full || f->size == fx25_size))
+		size = fx25_size;
+	else
+		c = -1;
+
+	for(uint32_t i = 0; i < (skip_preamble ? 0 : preamble); i += 8)
+		ref_put_byte(0x7E);
+	if(c < 0) {
+		for(uint32_t i = 0; i < len; i++)
+			ref_put(get_bit(bits, i));
+		return f->size == size;
+	}
+
+	uint8_t nroots = f->fx25;
+	uint8_t k = fx25_codes[c].k;
+	uint8_t block[255] = {0}, parity[RS8_MAX_NROOTS];
+	for(uint32_t i = 0; i < k * 8u; i++) {
+		uint8_t bit = i < len - 24 ? get_bit(bits, i + 24) : (0x7E >> ((i - (len - 24)) & 7)) & 1;
+		block[i >> 3] |= bit << (i & 7);
+	}
+	// Zeros behind the data fill the block of the full size code
+	encode_rs_8_code(nroots == 64 ? &RS8_FX25_64 : nroots == 32 ? &RS8_FX25_32 : &RS8_FX25_16,
+		block, parity, 0);
+
+	for(uint32_t i = 0; i < 32; i++)
+		ref_put(get_bit(bits, i));
+	for(uint8_t i = 0; i < 8; i++)
+		ref_put_byte(fx25_codes[c].tag >> (i * 8));
+	for(uint8_t i = 0; i < k; i++)
+		ref_put_byte(block[i]);
+	for(uint8_t i = 0; i < nroots; i++)
+		ref_put_byte(parity[i]);
+	return f->size == size;
+}
+
+/**
+ * Appends the frames of a packet to the reference. The preamble of the first
+ * frame sent is skipped if skip_preamble is set, the amount of bits skipped
+ * is returned in skipped. Returns false if the encoder dropped a frame it had
+ * room for or sized a frame differently.
+ */
+static bool ref_packet(const packet_t *p, bool skip_preamble, uint32_t *skipped)
+{
+	uint32_t start = ref_len;
+	bool ok = true;
+
+	*skipped = 0;
+	for(uint8_t i = 0; i < p->frames; i++)
+	{
+		const frame_t *f = &p->frame[i];
+		if(!f->size) { // Dropped
+			ok = ok && !p->full;
+			continue;
+		}
+		uint32_t pos = ref_len;
+		ok = ref_frame(f, p->ax25.mod, p->full, skip_preamble) && ok;
+		if(skip_preamble)
+			*skipped = f->size - (ref_len - pos);
+		skip_preamble = false;
+	}
+	return ok && ref_len - start == p->ax25.size - *skipped;
+}
+
+/* Scrambles (2GFSK) and NRZI encodes the reference from bit start on */
+static void ref_encode(uint32_t start, bool scramble)
+{
+	for(uint32_t i = start; i < ref_len; i++)
+	{
+		uint8_t bit = get_bit(ref_bits, i);
+		if(scramble)
+			bit = ref_scramble_bit(bit);
+		bit = ref_nrzi_bit(bit);
+		ref_bits[i >> 3] = (ref_bits[i >> 3] & ~(1 << (i & 7))) | bit << (i & 7);
+	}
+}
+
+/* Encodes a random APRS packet of 1-6 frames (see aprs.c) */
+static void random_packet(packet_t *p, uint8_t *buffer, mod_t mod)
+{
+	static const uint8_t fx25[] = {0, 16, 32, 64};
+	static const char *paths[] = {"", "WIDE1-1", "WIDE1-1,WIDE2-1"};
+	ax25_t *packet = &p->ax25;
+
+	// Small buffers drop frames exceeding their bit budget
+	p->full = rnd() % 4;
+	uint16_t size = p->full ? BUFFER_SIZE : 256 + rnd() % 1024;
+	packet->data = buffer;
+	packet->max_size = size;
+	packet->max_bits = size * 8;
+	packet->mod = mod;
+	ax25_init(packet);
+
+	p->frames = 1 + rnd() % 6;
+	for(uint8_t i = 0; i < p->frames; i++)
+	{
+		frame_t *f = &p->frame[i];
+		f->ssid = rnd() % 16;
+		f->path = paths[rnd() % 3];
+		f->preamble = i ? 0 : rnd() % 400;
+		f->fx25 = fx25[rnd() % 4];
+		f->len = rnd() % 257;
+		uint8_t mode = rnd() % 3; // Random bytes, all ones, text
+		for(uint16_t j = 0; j < f->len; j++)
+			f->info[j] = mode == 0 ? rnd() : mode == 1 ? 0xFF : 'A' + rnd() % 26;
+
+		uint32_t before = packet->size;
+		ax25_send_header(packet, "DL7AD", f->ssid, f->path, f->preamble, f->fx25);
+		for(uint16_t j = 0; j < f->len; j++)
+			ax25_send_byte(packet, f->info[j]);
+		ax25_send_footer(packet);
+		f->size = packet->size - before;
+	}
+}
+
+/* Reads size bits of the stream in random chunks of 1-8 bits */
+static void stream_chunks(ax25_stream_t *stream, uint8_t *out, uint32_t start, uint32_t size)
+{
+	for(uint32_t i = start; i < start + size; )
+	{
+		uint8_t num = 1 + rnd() % 8;
+		if(num > start + size - i)
+			num = start + size - i;
+		uint8_t bits = ax25_stream_get(stream, num);
+		for(uint8_t j = 0; j < num; j++, i++)
+		{
+			if((bits >> j) & 1)
+				out[i >> 3] |= 1 << (i & 7);
+			else
+				out[i >> 3] &= ~(1 << (i & 7));
+		}
+	}
+}
+
+static bool bits_equal(const uint8_t *a, const uint8_t *b, uint32_t len)
+{
+	if(memcmp(a, b, len >> 3))
+		return false;
+	uint8_t mask = (1 << (len & 7)) - 1;
+	return !(len & 7) || !((a[len >> 3] ^ b[len >> 3]) & mask);
+}
+
+/**
+ * Encodes random packets (AFSK and 2GFSK, AX.25 and FX.25 frames) with
+ * ax25_encode_buffer() and streams them in random chunks, also two packets
+ * as one continuous transmission (as the radio does). Both must be
+ * identical to the reference built by the baseline encoder, the packet size
+ * must match it and stay in the bit budget.
+ */
+static int test_stream(void)
+{
+	static uint8_t data[2][BUFFER_SIZE];
+	static uint8_t buffer[MAX_BITS / 8], streamed[MAX_BITS / 8];
+	static packet_t packet[2];
+	int fails = 0;
+
+	for(int n = 0; n < PACKETS; n++)
+	{
+		mod_t mod = n & 1 ? MOD_2GFSK : MOD_AFSK;
+		random_packet(&packet[0], data[0], mod);
+		random_packet(&packet[1], data[1], mod);
+
+		// Single packet
+		uint32_t skipped;
+		ref_len = 0;
+		ref_lfsr = 0;
+		ref_tone = 0;
+		bool ok = ref_packet(&packet[0], false, &skipped);
+		ref_encode(0, mod == MOD_2GFSK);
+		uint32_t size = ax25_encode_buffer(&packet[0].ax25, buffer);
+
+		ax25_stream_t stream;
+		ax25_stream_init(&stream, mod);
+		ax25_stream_load(&stream, data[0], false);
+		stream_chunks(&stream, streamed, 0, size);
+
+		ok = ok && size == ref_len && size <= packet[0].ax25.max_bits
+		     && bits_equal(buffer, ref_bits, size) && bits_equal(streamed, ref_bits, size);
+
+		// Second packet appended without preamble
+		uint32_t start = ref_len;
+		ok = ref_packet(&packet[1], true, &skipped) && ok;
+		ref_encode(start, mod == MOD_2GFSK);
+		ax25_stream_load(&stream, data[1], true);
+		stream_chunks(&stream, streamed, size, packet[1].ax25.size - skipped);
+
+		ok = ok && bits_equal(streamed, ref_bits, ref_len);
+
+		if(!ok && fails++ < 10)
+			printf("stream: packet %d (%s) size %u/%u, reference %u\n", n,
+				mod == MOD_2GFSK ? "2GFSK" : "AFSK", size, packet[1].ax25.size, ref_len);
+	}
+
+	printf("stream/buffer: %s\n", fails ? "FAIL" : "ok");
+	return fails;
+}
+
+int main(void)
+{
+	int fails = test_scrambler() + test_stream();
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+/* SSDV transcoding time of camera images whose tables match the SSDV quality
+ * (ssdv_conf.match_dqt) against images which have to be requantized. For
+ * every sample picture (or JPEG given as argument) and quality, the matched
+ * image is the picture transcoded to that quality once (the tables the camera
+ * produces at the matching quantization scale). The image transcoded to the
+ * other quality is requantized. The matched image must be passed through: its
+ * packets are the ones it has been decoded from. (Above quality 4, a second
+ * transcoding isn't bit-exact for all pictures, also with the SSDV coder of
+ * the baseline.) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ssdv.h"
+#include "ssdv_run.h"
+
+#define REPS		20
+#define MAX_JPEG	(1 << 20)
+#define MAX_PKTS	4096
+
+static const char *samples[] = {
+	"../doc/sample_pictures/test1.jpg",
+	"../doc/sample_pictures/test2.jpg",
+	"../doc/sample_pictures/test3.jpg",
+	"../doc/sample_pictures/test4.jpg"
+};
+
+static const int8_t qualities[] = {3, 4};
+#define QUALITIES (sizeof(qualities) / sizeof(qualities[0]))
+
+static uint8_t jpeg[MAX_JPEG], matched[QUALITIES][MAX_JPEG];
+static uint8_t pkts[MAX_PKTS * SSDV_PKT_SIZE], pkts_matched[MAX_PKTS * SSDV_PKT_SIZE];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	const char **files = argc > 1 ? (const char**)&argv[1] : samples;
+	int count = argc > 1 ? argc - 1 : (int)(sizeof(samples) / sizeof(samples[0]));
+	double t[QUALITIES][2] = {{0}};
+	size_t len[QUALITIES];
+	int n[QUALITIES];
+	int fails = 0;
+
+	for(int i = 0; i < count; i++)
+	{
+		FILE *f = fopen(files[i], "rb");
+		if(!f)
+		{
+			printf("%s: can't open\n", files[i]);
+			fails++;
+			continue;
+		}
+		size_t jpeg_len = fread(jpeg, 1, sizeof(jpeg), f);
+		fclose(f);
+
+		/* Images with the tables of each quality */
+		for(uint32_t q = 0; q < QUALITIES; q++)
+		{
+			n[q] = ssdv_run_encode(jpeg, jpeg_len, SSDV_TYPE_NORMAL, qualities[q], pkts, MAX_PKTS);
+			len[q] = n[q] > 0 ? ssdv_run_decode(pkts, n[q], matched[q], MAX_JPEG) : 0;
+			if(q == 0)
+				memcpy(pkts_matched, pkts, n[q] > 0 ? n[q] * SSDV_PKT_SIZE : 0);
+		}
+
+		for(uint32_t q = 0; q < QUALITIES; q++)
+		{
+			uint32_t o = (q + 1) % QUALITIES; // Image with the tables of another quality
+			int nm = 0, nr = 0;
+
+			/* Packets the matched image has been decoded from */
+			if(q && n[q] > 0)
+				ssdv_run_encode(jpeg, jpeg_len, SSDV_TYPE_NORMAL, qualities[q], pkts_matched, MAX_PKTS);
+
+			double t0 = now();
+			for(int r = 0; r < REPS; r++)
+				nm = ssdv_run_encode(matched[q], len[q], SSDV_TYPE_NORMAL, qualities[q], pkts, MAX_PKTS);
+			double t1 = now();
+			int fail = !len[q] || nm != n[q] || memcmp(pkts, pkts_matched, nm * SSDV_PKT_SIZE);
+			for(int r = 0; r < REPS; r++)
+				nr = ssdv_run_encode(matched[o], len[o], SSDV_TYPE_NORMAL, qualities[q], pkts, MAX_PKTS);
+			double t2 = now();
+			fail |= !len[o] || nr <= 0;
+
+			t[q][0] += t1 - t0;
+			t[q][1] += t2 - t1;
+
+			printf("%s (quality %d): %d packets matched, %d requantized: %s\n", files[i], qualities[q], nm, nr, fail ? "FAIL" : "ok");
+			fails += fail;
+		}
+	}
+
+	for(uint32_t q = 0; q < QUALITIES; q++)
+		printf("bench quality %d: %7.2f ms matched, %7.2f ms requantized\n", qualities[q],
+			t[q][0] * 1e3 / REPS, t[q][1] * 1e3 / REPS);
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,556 @@
+/* FIFO feeder of the radio (radio.c) with a simulated Si4464. radio.c is
+ * included, so the test can call its static functions. */
+
+#include "debug.h"	// Host stub, radio.c includes the firmware one
+#include "../radio.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SESSIONS	500
+#define BENCH_REPS	200
+
+static uint32_t seed = 0x12345678;
+static uint32_t rnd(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/* Simulated time in ns */
+static uint64_t sim_time;
+
+systime_t chVTGetSystemTimeX(void)
+{
+	return sim_time * CH_CFG_ST_FREQUENCY / 1000000000;
+}
+
+void chThdSleepMilliseconds(uint32_t msec)
+{
+	sim_time += (uint64_t)msec * 1000000;
+}
+
+trackPoint_t* getLastTrackPoint(void)
+{
+	return NULL;
+}
+
+/*
+ * Si4464 model: The FIFO (SI4464_FIFO_SIZE bytes) is drained at the data rate
+ * of the message once radioTune() has started the transmission. A byte leaves
+ * the FIFO when it has been sent completely. The FIFO feeder is woken up
+ * latency ns after the threshold has been reached (or the wait timed out). If
+ * the threshold interrupt is lost, the feeder is only woken by the timeout.
+ */
+static struct {
+	uint64_t latency;	// Wakeup latency of the feeder (ns)
+	bool jitter;		// Random latency up to latency
+	bool lost;			// Threshold interrupts are lost
+	bool tx;			// Transmitting
+	uint64_t start;		// Start of transmission (ns)
+	uint32_t rate;		// Data rate (bit/s)
+	uint16_t size;		// Bytes of the transmission
+	uint32_t written;	// Bytes written into the FIFO
+	uint8_t thres;		// Free bytes at which the threshold is signaled
+	uint32_t refills;	// Refills (threshold waits)
+	uint32_t timeouts;	// Threshold waits timed out
+	uint32_t underruns;	// FIFO ran empty while the transmission wasn't complete
+	uint32_t overflows;	// More bytes written than free
+	int64_t margin;		// Smallest time left until the FIFO would run empty (ns)
+	uint8_t data[SI4464_MAX_TX_LEN];	// Bytes written into the FIFO
+} si;
+
+/* Bytes sent completely */
+static uint32_t si_sent(void)
+{
+	if(!si.tx)
+		return 0;
+	uint64_t sent = (sim_time - si.start) * si.rate / 8000000000;
+	return sent < si.written ? sent : si.written;
+}
+
+/* Time at which the FIFO runs empty */
+static uint64_t si_empty_time(void)
+{
+	return si.start + ((uint64_t)si.written * 8000000000 + si.rate - 1) / si.rate;
+}
+
+void Si4464_Init(void) {}
+void Si4464_addSynthFrequency(uint32_t freq) {}
+void setModemAFSK(void) {}
+void setModemOOK(ook_conf_t* conf) {}
+void setModem2FSK(fsk_conf_t* conf) {}
+void setModem2GFSK(gfsk_conf_t* conf) {}
+uint32_t Si4464_getSPICount(void) { return 0; }
+
+bool radioTune(uint32_t frequency, uint16_t shift, int8_t level, uint16_t size)
+{
+	si.tx = true;
+	si.start = sim_time;
+	si.rate = getFIFORate();
+	si.size = size;
+	return true;
+}
+
+void Si4464_shutdown(void)
+{
+	si.tx = false;
+}
+
+uint8_t Si4464_freeFIFO(void)
+{
+	return SI4464_FIFO_SIZE - (si.written - si_sent());
+}
+
+void Si4464_writeFIFO(uint8_t *msg, uint8_t size)
+{
+	if(si.tx && si.written < si.size)
+	{
+		int64_t margin = (int64_t)si_empty_time() - (int64_t)sim_time;
+		if(margin < si.margin)
+			si.margin = margin;
+		if(margin < 0)
+			si.underruns++;
+	}
+	if(size > Si4464_freeFIFO())
+		si.overflows++;
+	if(si.written + size <= sizeof(si.data))
+		memcpy(&si.data[si.written], msg, size);
+	si.written += size;
+}
+
+void Si4464_setFIFOThreshold(uint8_t thres)
+{
+	si.thres = thres;
+}
+
+bool Si4464_waitFIFO(systime_t timeout)
+{
+	si.refills++;
+	if(Si4464_freeFIFO() >= si.thres) // Already below threshold
+		return true;
+
+	uint64_t timeout_ns = (uint64_t)timeout * 1000000000 / CH_CFG_ST_FREQUENCY;
+	uint32_t sent = si.written - (SI4464_FIFO_SIZE - si.thres); // Sent bytes at the threshold
+	uint64_t event = si.start + ((uint64_t)sent * 8000000000 + si.rate - 1) / si.rate;
+	uint64_t latency = si.jitter ? rnd() % (si.latency + 1) : si.latency;
+	if(si.tx && !si.lost && event <= sim_time + timeout_ns) {
+		sim_time = event + latency;
+		return true;
+	}
+	sim_time += timeout_ns + latency;
+	si.timeouts++;
+	return false;
+}
+
+uint8_t Si4464_getState(void)
+{
+	if(si.tx && si_sent() < si.size)
+		return SI4464_STATE_TX;
+	return SI4464_STATE_READY;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Encodes a random message of 1-4 APRS frames into buffer (see aprs.c) */
+static void random_msg(radioMSG_t *msg, uint8_t *buffer, mod_t mod)
+{
+	ax25_t packet;
+	packet.data = buffer;
+	packet.max_size = RADIO_BUFFER_SIZE;
+	packet.max_bits = RADIO_MAX_TX_BITS(mod); // As aprs_encode_init()
+	packet.mod = mod;
+	ax25_init(&packet);
+
+	uint8_t frames = 1 + rnd() % 4;
+	for(uint8_t f = 0; f < frames; f++)
+	{
+		ax25_send_header(&packet, "DL7AD", 11, "WIDE1-1", f ? 0 : 50 + rnd() % 300, rnd() % 2 ? 32 : 0);
+		uint16_t len = rnd() % 257;
+		for(uint16_t i = 0; i < len; i++)
+			ax25_send_byte(&packet, rnd());
+		ax25_send_footer(&packet);
+	}
+
+	memset(msg, 0, sizeof(radioMSG_t));
+	msg->buffer = buffer;
+	msg->bin_len = packet.size;
+	msg->preamble_len = packet.preamble;
+	msg->mod = mod;
+}
+
+/* Sets up a session of n messages like the radio manager does */
+static void load_session(radioMSG_t *msgs, uint8_t n)
+{
+	for(uint8_t i = 0; i < n; i++)
+	{
+		radio_jobs[i].msg = msgs[i];
+		session[i] = &radio_jobs[i];
+	}
+	session_len = n;
+	session_pos = 0;
+	radio_msg = msgs[0];
+}
+
+/**
+ * Returns the NRZI bits of a session of n messages (as the radio sends them)
+ * in bits, appended messages skip their preamble. Returns the amount of bits.
+ */
+static uint32_t session_bits(radioMSG_t *msgs, uint8_t n, uint8_t *bits)
+{
+	ax25_stream_t stream;
+	uint32_t len = 0;
+
+	ax25_stream_init(&stream, msgs[0].mod);
+	for(uint8_t i = 0; i < n; i++)
+	{
+		ax25_stream_load(&stream, msgs[i].buffer, i > 0);
+		for(uint32_t j = i ? msgs[i].preamble_len : 0; j < msgs[i].bin_len; j++, len++)
+		{
+			if(!(len & 7))
+				bits[len >> 3] = 0;
+			bits[len >> 3] |= ax25_stream_get(&stream, 1) << (len & 7);
+		}
+	}
+	return len;
+}
+
+/**
+ * AFSK modulation, one sample per step as before the phase table. The phase
+ * is counted in 1/PHASE_CYCLE of a tone cycle, so both tones advance by an
+ * integer and the reference is exact. The tone is high in the second half
+ * of the cycle, a phase exactly at the half or full cycle counts to the half
+ * before.
+ */
+static uint32_t ref_afsk(const uint8_t *bits, uint32_t len, uint8_t *samples)
+{
+	uint32_t ph = 0, n = 0;
+	for(uint32_t i = 0; i < len; i++)
+	{
+		uint8_t bit = (bits[i >> 3] >> (i & 7)) & 1;
+		for(uint8_t s = 0; s < SAMPLES_PER_BAUD; s++, n++)
+		{
+			ph = (ph + (bit ? PHASE_DELTA_1200 : PHASE_DELTA_2200)) % PHASE_CYCLE;
+			if(!(n & 7))
+				samples[n >> 3] = 0;
+			samples[n >> 3] |= (ph > PHASE_CYCLE/2 || ph == 0) << (n & 7);
+		}
+	}
+	return (n + 7) / 8;
+}
+
+#define OLD_CYCLE		(2 << 16)	/* Tone cycle of the baseline accumulator */
+#define OLD_DELTA(f)	(((2 * (f)) << 16) / PLAYBACK_RATE)
+
+/**
+ * AFSK modulation of the baseline: a 16.16 phase accumulator with truncated
+ * deltas. Returns the amount of samples until its phase is behind the exact
+ * one by 1/PHASE_CYCLE of a cycle. Up to there it can't cross another half
+ * cycle than the exact phase does.
+ */
+static uint32_t old_afsk(const uint8_t *bits, uint32_t len, uint8_t *samples)
+{
+	uint32_t ph = 0, n = 0, exact = 0;
+	uint64_t behind = 0; // Truncated parts of the deltas in 1/PLAYBACK_RATE
+	for(uint32_t i = 0; i < len; i++)
+	{
+		uint8_t bit = (bits[i >> 3] >> (i & 7)) & 1;
+		uint32_t f = bit ? 1200 : 2200;
+		for(uint8_t s = 0; s < SAMPLES_PER_BAUD; s++, n++)
+		{
+			ph += OLD_DELTA(f);
+			behind += ((2 * f) << 16) % PLAYBACK_RATE;
+			if(behind < (uint64_t)OLD_CYCLE * PLAYBACK_RATE / PHASE_CYCLE)
+				exact = n + 1;
+			if(!(n & 7))
+				samples[n >> 3] = 0;
+			samples[n >> 3] |= ((ph >> 16) & 1) << (n & 7);
+		}
+	}
+	return exact;
+}
+
+/* Returns true if the first n samples are equal */
+static bool samples_equal(const uint8_t *a, const uint8_t *b, uint32_t n)
+{
+	if(memcmp(a, b, n >> 3))
+		return false;
+	return !(n & 7) || !((a[n >> 3] ^ b[n >> 3]) & ((1 << (n & 7)) - 1));
+}
+
+/* Runs the AFSK part of the FIFO feeder (si_fifo_feeder_thd2) */
+static uint32_t feed_afsk(uint8_t *out)
+{
+	phase = 0;
+	session_pos = 0;
+	ax25_stream_init(&tx_stream, MOD_AFSK);
+	nextSessionJob(&packet_pos);
+	afsk_samples = 0;
+	afsk_sample_cnt = 0;
+
+	uint16_t all = getSessionSize();
+	for(uint16_t i = 0; i < all; i++)
+		out[i] = getAFSKbyte();
+	return all;
+}
+
+/**
+ * Modulates random AFSK sessions (1-3 messages) with the phase table. The
+ * samples must be equal to the exact reference, and to the baseline
+ * accumulator as long as its truncated deltas keep it exact.
+ */
+static int test_afsk(void)
+{
+	static uint8_t buffers[3][RADIO_BUFFER_SIZE];
+	static uint8_t bits[3 * RADIO_BUFFER_SIZE];
+	static uint8_t out[3 * RADIO_BUFFER_SIZE * SAMPLES_PER_BAUD];
+	static uint8_t ref[3 * RADIO_BUFFER_SIZE * SAMPLES_PER_BAUD];
+	uint64_t old_exact = 0;
+	int fails = 0;
+
+	initAFSKTable();
+	for(int n = 0; n < SESSIONS; n++)
+	{
+		radioMSG_t msgs[3];
+		uint8_t len = 1 + rnd() % 3;
+		for(uint8_t i = 0; i < len; i++)
+			random_msg(&msgs[i], buffers[i], MOD_AFSK);
+		load_session(msgs, len);
+
+		uint32_t all = feed_afsk(out);
+		uint32_t nbits = session_bits(msgs, len, bits);
+		uint32_t ref_len = ref_afsk(bits, nbits, ref);
+		bool ok = all == ref_len && !memcmp(out, ref, all);
+
+		uint32_t exact = old_afsk(bits, nbits, ref);
+		ok = ok && samples_equal(out, ref, exact);
+		old_exact += exact;
+
+		if(!ok && fails++ < 10)
+			printf("afsk: session %d (%d messages, %u bits) differs\n", n, len, nbits);
+	}
+
+	printf("afsk: %s (equal to the baseline for the first %llu samples on average)\n",
+		fails ? "FAIL" : "ok", (unsigned long long)old_exact / SESSIONS);
+	return fails;
+}
+
+static void bench_afsk(void)
+{
+	static uint8_t buffer[RADIO_BUFFER_SIZE];
+	static uint8_t bits[RADIO_BUFFER_SIZE];
+	static uint8_t out[RADIO_BUFFER_SIZE * SAMPLES_PER_BAUD];
+	radioMSG_t msg;
+
+	random_msg(&msg, buffer, MOD_AFSK);
+	load_session(&msg, 1);
+	uint32_t nbits = session_bits(&msg, 1, bits);
+
+	double t0 = now();
+	for(int r = 0; r < BENCH_REPS; r++)
+		old_afsk(bits, nbits, out);
+	double t1 = now();
+	for(int r = 0; r < BENCH_REPS; r++)
+		feed_afsk(out);
+	double t2 = now();
+
+	printf("bench afsk: %6.1f ns/bit per sample, %6.1f ns/bit with table (HDLC encoding included)\n",
+		(t1 - t0) * 1e9 / BENCH_REPS / nbits, (t2 - t1) * 1e9 / BENCH_REPS / nbits);
+}
+
+typedef struct {
+	const char *name;
+	mod_t mod;
+	uint32_t speed;	// 2GFSK
+} fifo_case_t;
+
+static const fifo_case_t fifo_cases[] = {
+	{"2GFSK 9600",  MOD_2GFSK, 9600},
+	{"2GFSK 19200", MOD_2GFSK, 19200},
+	{"AFSK 1200",   MOD_AFSK,  0}
+};
+
+/**
+ * Transmits a random session of 1-3 messages (as long as it fits into one
+ * transmission) with the FIFO feeder of the radio manager and the Si4464
+ * model. Returns false if the FIFO ran empty or overflowed, or if the
+ * transmitted bytes aren't the modulated messages.
+ */
+static bool fifo_session(const fifo_case_t *c, uint64_t latency, bool jitter, bool lost)
+{
+	static uint8_t buffers[3][RADIO_BUFFER_SIZE];
+	static uint8_t bits[3 * RADIO_BUFFER_SIZE];
+	static uint8_t ref[3 * RADIO_BUFFER_SIZE * SAMPLES_PER_BAUD];
+	static gfsk_conf_t gfsk_conf;
+	radioMSG_t msgs[3];
+	uint8_t len = 0, max = 1 + rnd() % 3;
+	uint32_t fifo_bits = 0;
+
+	gfsk_conf.speed = c->speed;
+	while(len < max) {
+		random_msg(&msgs[len], buffers[len], c->mod);
+		msgs[len].gfsk_conf = &gfsk_conf;
+		fifo_bits += getFIFOBits(&msgs[len], len == 0);
+		if(len && (fifo_bits + 7) / 8 > SI4464_MAX_TX_LEN)
+			break; // As buildSession()
+		len++;
+	}
+	load_session(msgs, len);
+
+	memset(&si, 0, sizeof(si));
+	si.latency = latency;
+	si.jitter = jitter;
+	si.lost = lost;
+	si.margin = INT64_MAX;
+	sim_time = 0;
+	nextTransmissionWaiting = false;
+
+	if(c->mod == MOD_AFSK) {
+		initAFSKTable();
+		si_fifo_feeder_thd2(NULL);
+	} else {
+		si_fifo_feeder_thd(NULL);
+	}
+
+	uint32_t nbits = session_bits(msgs, len, bits);
+	uint32_t ref_len = c->mod == MOD_AFSK ? ref_afsk(bits, nbits, ref) : (nbits + 7) / 8;
+	const uint8_t *expected = c->mod == MOD_AFSK ? ref : bits;
+
+	return !si.underruns && !si.overflows && !si.tx && si.written == ref_len && si.size == ref_len
+	    && !memcmp(si.data, expected, ref_len);
+}
+
+/**
+ * Transmits random sessions at 9600 and 19200 baud 2GFSK and AFSK with a
+ * feeder wakeup latency of FIFO_LATENCY (and random latencies up to it), also
+ * with lost threshold interrupts. The FIFO must neither run empty nor
+ * overflow, data must be left in it after FIFO_LATENCY. The largest latency
+ * without an underrun is determined too, it must exceed FIFO_LATENCY.
+ */
+static int test_fifo(void)
+{
+	int fails = 0;
+
+	for(uint32_t i = 0; i < sizeof(fifo_cases) / sizeof(fifo_cases[0]); i++) {
+		const fifo_case_t *c = &fifo_cases[i];
+		int case_fails = 0;
+		int64_t margin = INT64_MAX, lost_margin = INT64_MAX;
+		uint32_t refills = 0, timeouts = 0;
+
+		for(int n = 0; n < SESSIONS / 5; n++) {
+			bool jitter = n & 1;
+			bool lost = n % 4 >= 2;
+			if(!fifo_session(c, (uint64_t)FIFO_LATENCY * 1000000, jitter, lost))
+				case_fails++;
+			if(!jitter && !lost && si.margin < margin)
+				margin = si.margin;
+			if(!jitter && lost && si.margin < lost_margin)
+				lost_margin = si.margin;
+			if(!lost) {
+				refills += si.refills;
+				timeouts += si.timeouts;
+			}
+		}
+		case_fails += margin <= 0 || lost_margin <= 0;
+
+		// Refill size of this data rate
+		bool refill_ok = fifo_refill >= FIFO_REFILL_MIN && fifo_refill <= FIFO_REFILL_MAX;
+		case_fails += !refill_ok;
+
+		// Largest latency (in 0.5 ms steps) the FIFO copes with
+		uint32_t tolerated = 0;
+		for(uint32_t l = 1; l <= 4 * FIFO_LATENCY; l++) {
+			uint32_t s = seed;
+			bool ok = true;
+			for(int n = 0; n < 10 && ok; n++)
+				ok = fifo_session(c, (uint64_t)l * 500000, false, false);
+			seed = s;
+			if(!ok)
+				break;
+			tolerated = l;
+		}
+		case_fails += tolerated <= 2 * FIFO_LATENCY;
+
+		printf("fifo %-11s: %s (refill %3d bytes, %5.1f ms left at the threshold, min. %4.1f ms left after %d ms latency, "
+			"%4.1f ms after a lost interrupt, %.1f ms latency tolerated, %u refills, %u timeouts)\n",
+			c->name, case_fails ? "FAIL" : "ok", fifo_refill,
+			(SI4464_FIFO_SIZE - fifo_refill) * 8000.0 / getFIFORate(), margin / 1e6, FIFO_LATENCY,
+			lost_margin / 1e6, tolerated / 2.0, refills, timeouts);
+		fails += case_fails;
+	}
+	return fails;
+}
+
+/* Queues a message of priority prio and deadline ms into radio buffer i */
+static void queue_job(uint8_t i, uint8_t prio, uint32_t deadline)
+{
+	static freq_conf_t freq = {FREQ_STATIC, 144800000};
+	radioMSG_t msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.buffer = radio_buffers[i];
+	msg.bin_len = 8;
+	msg.mod = MOD_AFSK;
+	msg.priority = prio;
+	msg.deadline = deadline;
+	msg.freq = &freq;
+	transmitOnRadio(&msg, 0);
+}
+
+/*
+ * Scheduling by priority and deadline with the default deadlines of the
+ * modules. The deadline of an image (600 s) overflowed MS2ST() and expired
+ * after 170 s.
+ */
+static int test_deadline(void)
+{
+	static const struct {
+		const char *name;
+		uint32_t t[2];			// Queued at (s)
+		uint8_t prio[2];
+		uint32_t deadline[2];	// ms
+		uint32_t now;			// Selected at (s)
+		uint8_t expected;		// Job transmitted first
+	} cases[] = {
+		{"image waiting 200 s, log",      {0, 200},   {RADIO_PRIO_IMAGE, RADIO_PRIO_LOG},      {RADIO_DEADLINE_IMAGE, RADIO_DEADLINE_LOG},      200,  1},
+		{"image waiting 599 s, position", {0, 599},   {RADIO_PRIO_IMAGE, RADIO_PRIO_POSITION}, {RADIO_DEADLINE_IMAGE, RADIO_DEADLINE_POSITION}, 599,  1},
+		{"image waiting 600 s, position", {0, 600},   {RADIO_PRIO_IMAGE, RADIO_PRIO_POSITION}, {RADIO_DEADLINE_IMAGE, RADIO_DEADLINE_POSITION}, 600,  0},
+		{"image late, log late",          {0, 1000},  {RADIO_PRIO_IMAGE, RADIO_PRIO_LOG},      {RADIO_DEADLINE_IMAGE, RADIO_DEADLINE_LOG},      1100, 1},
+		{"two images, earliest deadline", {0, 100},   {RADIO_PRIO_IMAGE, RADIO_PRIO_IMAGE},    {RADIO_DEADLINE_IMAGE, 400000},                  200,  1},
+		{"two images, earliest deadline", {0, 100},   {RADIO_PRIO_IMAGE, RADIO_PRIO_IMAGE},    {RADIO_DEADLINE_IMAGE, 600000},                  200,  0},
+		{"position 1 h, image 1 h",       {0, 0},     {RADIO_PRIO_POSITION, RADIO_PRIO_IMAGE}, {3600000, 3600000},                              3599, 0},
+	};
+	int fails = 0;
+
+	for(uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		memset(radio_jobs, 0, sizeof(radio_jobs));
+		for(uint8_t j = 0; j < 2; j++) {
+			sim_time = (uint64_t)cases[i].t[j] * 1000000000;
+			queue_job(j, cases[i].prio[j], cases[i].deadline[j]);
+		}
+		sim_time = (uint64_t)cases[i].now * 1000000000;
+		radio_job_t *job = selectJobS(NULL, 0);
+		bool ok = job == &radio_jobs[cases[i].expected];
+		if(!ok) {
+			printf("deadline %s: FAIL (job %d instead of %d first)\n", cases[i].name,
+				job ? (int)(job - radio_jobs) : -1, cases[i].expected);
+			fails++;
+		}
+	}
+	printf("deadline: %s\n", fails ? "FAIL" : "ok");
+	return fails;
+}
+
+int main(void)
+{
+	int fails = test_afsk() + test_fifo() + test_deadline();
+	bench_afsk();
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+/* Reed-Solomon coder (protocols/ssdv/rs8.c) against independent references:
+ * the baseline coder (ref/rs8_ref.c) for the SSDV (CCSDS) code and a textbook
+ * encoder for the FX.25 codes (generator polynomial built from gfpoly 0x11D,
+ * fcr 1, prim 1). Checks that parity and decoding are bit-exact, with and
+ * without padding, and compares the encoder speed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rs8.h"
+#include "ref/ref.h"
+
+#define BLOCKS		20000
+#define BENCH_REPS	20000
+
+static uint32_t seed = 0x12345678;
+static uint32_t rnd(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+	const char *name;
+	const rs8_code_t *code;
+	uint8_t genpoly[RS8_MAX_NROOTS + 1]; // Textbook generator, highest power first
+} code_t;
+
+static code_t codes[] = {
+	{"CCSDS",    NULL},
+	{"FX.25/16", &RS8_FX25_16},
+	{"FX.25/32", &RS8_FX25_32},
+	{"FX.25/64", &RS8_FX25_64}
+};
+#define CODES (sizeof(codes) / sizeof(codes[0]))
+
+/* GF(256) with the FX.25 field polynomial x^8+x^4+x^3+x^2+1 */
+static uint8_t gf_exp[255], gf_log[256];
+
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+	return a && b ? gf_exp[(gf_log[a] + gf_log[b]) % 255] : 0;
+}
+
+/* g(x) = (x - a^1)(x - a^2)...(x - a^nroots) */
+static void fx25_init(void)
+{
+	for(int i = 0, x = 1; i < 255; i++)
+	{
+		gf_exp[i] = x;
+		gf_log[x] = i;
+		x = x << 1 ^ (x & 0x80 ? 0x11D : 0);
+	}
+
+	for(uint32_t c = 0; c < CODES; c++)
+	{
+		if(!codes[c].code)
+			continue;
+		uint8_t *g = codes[c].genpoly;
+		g[0] = 1;
+		for(int i = 1; i <= codes[c].code->nroots; i++)
+		{
+			g[i] = 0;
+			for(int j = i; j > 0; j--)
+				g[j] ^= gf_mul(g[j - 1], gf_exp[i]);
+		}
+	}
+}
+
+/* Remainder of data(x) * x^nroots divided by g(x), with a shift register */
+static void fx25_encode(const code_t *c, const uint8_t *data, uint8_t *parity, int pad)
+{
+	int nroots = c->code->nroots;
+
+	memset(parity, 0, nroots);
+	for(int i = 0; i < 255 - nroots - pad; i++)
+	{
+		uint8_t fb = data[i] ^ parity[0];
+		memmove(parity, &parity[1], nroots - 1);
+		parity[nroots - 1] = 0;
+		for(int j = 0; j < nroots; j++)
+			parity[j] ^= gf_mul(fb, c->genpoly[j + 1]);
+	}
+}
+
+static void encode(const code_t *c, uint8_t *data, uint8_t *parity, int pad)
+{
+	if(c->code) encode_rs_8_code(c->code, data, parity, pad);
+	else encode_rs_8(data, parity, pad);
+}
+
+static void encode_ref(const code_t *c, uint8_t *data, uint8_t *parity, int pad)
+{
+	if(c->code) fx25_encode(c, data, parity, pad);
+	else ref_encode_rs_8(data, parity, pad);
+}
+
+static int test_encode(void)
+{
+	uint8_t data[255], parity[RS8_MAX_NROOTS], parity_ref[RS8_MAX_NROOTS];
+	int fails = 0;
+
+	for(uint32_t c = 0; c < CODES; c++)
+	{
+		int nroots = codes[c].code ? codes[c].code->nroots : 32;
+		for(int n = 0; n < BLOCKS; n++)
+		{
+			/* Every second block is a padded (shortened) one */
+			int pad = n & 1 ? rnd() % (255 - nroots) : 0;
+			for(int i = 0; i < 255; i++)
+				data[i] = n < 2 ? (n ? 0xFF : 0x00) : rnd();
+
+			encode(&codes[c], data, parity, pad);
+			encode_ref(&codes[c], data, parity_ref, pad);
+			if(memcmp(parity, parity_ref, nroots))
+			{
+				if(fails++ < 10)
+					printf("encode %s: block %d (pad %d) differs\n", codes[c].name, n, pad);
+			}
+		}
+	}
+
+	printf("encode: %s\n", fails ? "FAIL" : "ok");
+	return fails;
+}
+
+static int test_decode(void)
+{
+	uint8_t block[255], block_ref[255];
+	int eras[32], eras_ref[32];
+	int fails = 0;
+
+	for(int n = 0; n < BLOCKS; n++)
+	{
+		int pad = n & 1 ? rnd() % 223 : 0;
+		int len = 255 - pad;
+		for(int i = 0; i < len - 32; i++)
+			block[i] = rnd();
+		encode_rs_8(block, &block[len - 32], pad);
+
+		/* Up to 19 errors, correctable up to 16; some of them as erasures */
+		int errors = rnd() % 20;
+		int no_eras = n & 2 ? rnd() % (errors + 1) : 0;
+		for(int e = 0; e < errors; e++)
+		{
+			int pos = rnd() % len;
+			block[pos] ^= 1 + rnd() % 255;
+			if(e < no_eras) eras[e] = pos;
+		}
+		memcpy(block_ref, block, len);
+		memcpy(eras_ref, eras, sizeof(eras));
+
+		int r = decode_rs_8(block, eras, no_eras, pad);
+		int r_ref = ref_decode_rs_8(block_ref, eras_ref, no_eras, pad);
+		if(r != r_ref || memcmp(block, block_ref, len)
+		|| (r > 0 && memcmp(eras, eras_ref, r * sizeof(int))))
+		{
+			if(fails++ < 10)
+				printf("decode: block %d (pad %d, %d errors) returned %d, reference %d\n", n, pad, errors, r, r_ref);
+		}
+	}
+
+	printf("decode: %s\n", fails ? "FAIL" : "ok");
+	return fails;
+}
+
+static void bench(void)
+{
+	uint8_t data[255], parity[RS8_MAX_NROOTS];
+
+	for(int i = 0; i < 255; i++)
+		data[i] = rnd();
+
+	for(uint32_t c = 0; c < CODES; c++)
+	{
+		double t0 = now();
+		for(int n = 0; n < BENCH_REPS; n++)
+			encode_ref(&codes[c], data, parity, 0);
+		double t1 = now();
+		for(int n = 0; n < BENCH_REPS; n++)
+			encode(&codes[c], data, parity, 0);
+		double t2 = now();
+
+		printf("bench %-8s: %6.2f us/block reference, %6.2f us/block now\n", codes[c].name,
+			(t1 - t0) * 1e6 / BENCH_REPS, (t2 - t1) * 1e6 / BENCH_REPS);
+	}
+}
+
+int main(void)
+{
+	fx25_init();
+	int fails = test_encode() + test_decode();
+	bench();
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+/* SSDV coder (protocols/ssdv/ssdv.c) against the baseline version without the
+ * Huffman lookup tables (ref/ssdv_ref.c). Encodes the sample pictures (or the
+ * JPEGs given as arguments), checks that packets and decoded images are
+ * bit-exact and compares the encoding and decoding time. The thumbnails
+ * collected while encoding are checked too. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ssdv.h"
+#include "ssdv_run.h"
+#include "ref/ref.h"
+
+#define REPS		20
+#define QUALITY		4
+#define MAX_JPEG	(1 << 20)
+#define MAX_PKTS	4096
+
+static const char *samples[] = {
+	"../doc/sample_pictures/test1.jpg",
+	"../doc/sample_pictures/test2.jpg",
+	"../doc/sample_pictures/test3.jpg",
+	"../doc/sample_pictures/test4.jpg"
+};
+
+static uint8_t jpeg[MAX_JPEG], out[MAX_JPEG], out_ref[MAX_JPEG], thumb[MAX_JPEG];
+static size_t jpeg_len;
+static uint8_t pkts[MAX_PKTS * SSDV_PKT_SIZE], pkts_ref[MAX_PKTS * SSDV_PKT_SIZE];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int test_file(const char *name, uint8_t type, double t[4])
+{
+	FILE *f = fopen(name, "rb");
+	if(!f)
+	{
+		printf("%s: can't open\n", name);
+		return 1;
+	}
+	size_t len = jpeg_len = fread(jpeg, 1, sizeof(jpeg), f);
+	fclose(f);
+
+	int n = 0, n_ref = 0;
+	size_t dlen = 0, dlen_ref = 0;
+	double t0 = now();
+	for(int r = 0; r < REPS; r++)
+		n_ref = ref_ssdv_encode(jpeg, len, type, QUALITY, pkts_ref, MAX_PKTS);
+	double t1 = now();
+	for(int r = 0; r < REPS; r++)
+		n = ssdv_run_encode(jpeg, len, type, QUALITY, pkts, MAX_PKTS);
+	double t2 = now();
+	for(int r = 0; r < REPS && n_ref > 0; r++)
+		dlen_ref = ref_ssdv_decode(pkts_ref, n_ref, out_ref, sizeof(out_ref));
+	double t3 = now();
+	for(int r = 0; r < REPS && n > 0; r++)
+		dlen = ssdv_run_decode(pkts, n, out, sizeof(out));
+	double t4 = now();
+
+	t[0] += t1 - t0;
+	t[1] += t2 - t1;
+	t[2] += t3 - t2;
+	t[3] += t4 - t3;
+
+	int fail = n <= 0 || n != n_ref || memcmp(pkts, pkts_ref, n * SSDV_PKT_SIZE)
+	        || !dlen || dlen != dlen_ref || memcmp(out, out_ref, dlen);
+	printf("%s (type %d): %d packets, %zu byte image: %s\n", name, type, n, dlen, fail ? "FAIL" : "ok");
+	return fail;
+}
+
+/* Collects the thumbnail of scale 1, 2 and 4 while encoding. The mean of
+ * its luminance has to be the mean of the DC coefficients of the image and
+ * the thumbnail JPEG has to pass the SSDV coder. */
+static int test_thumb(const char *name, size_t len)
+{
+	static uint8_t pkt[SSDV_PKT_SIZE];
+	int fails = 0;
+
+	for(uint8_t scale = 1; scale <= 4; scale *= 2)
+	{
+		ssdv_t s;
+		size_t fed = 0, tlen = 0;
+		char c;
+
+		ssdv_enc_init(&s, SSDV_TYPE_NOFEC, "DL7AD", 1, QUALITY);
+		ssdv_enc_set_buffer(&s, pkt);
+		ssdv_enc_set_thumb(&s, scale, thumb, sizeof(thumb) / 2);
+		do {
+			while((c = ssdv_enc_get_packet(&s)) == SSDV_FEED_ME && fed < len)
+			{
+				size_t r = len - fed < SSDV_RUN_FEED ? len - fed : SSDV_RUN_FEED;
+				ssdv_enc_feed(&s, &jpeg[fed], r);
+				fed += r;
+			}
+		} while(c == SSDV_OK);
+
+		/* Luminance plane */
+		uint32_t yw = s.width / 8 * scale, yh = s.height / 8 * scale, sum = 0;
+		for(uint32_t i = 0; i < yw * yh; i++)
+			sum += thumb[i];
+		double mean = (double)sum / (yw * yh);
+		double dc_mean = s.dc_count ? (double)s.dc_sum / s.dc_count + 128 : 0;
+
+		int n = -1;
+		if(c == SSDV_EOI)
+		{
+			tlen = sizeof(thumb) / 2;
+			if(ssdv_thumb_get_jpeg(&s, QUALITY, &thumb[sizeof(thumb) / 2], &tlen) != SSDV_OK)
+				tlen = 0;
+			n = ssdv_run_encode(&thumb[sizeof(thumb) / 2], tlen, SSDV_TYPE_NOFEC, QUALITY, pkts, MAX_PKTS);
+		}
+
+		int fail = c != SSDV_EOI || mean < dc_mean - 1 || mean > dc_mean + 1 || n <= 0 || !ssdv_run_decode(pkts, n, out, sizeof(out));
+		printf("%s (thumbnail %d/8): %ux%u, %zu byte JPEG, %d packets, mean %.1f (DC %.1f): %s\n",
+			name, scale, yw, yh, tlen, n, mean, dc_mean, fail ? "FAIL" : "ok");
+		fails += fail;
+	}
+	return fails;
+}
+
+int main(int argc, char **argv)
+{
+	const char **files = argc > 1 ? (const char**)&argv[1] : samples;
+	int count = argc > 1 ? argc - 1 : (int)(sizeof(samples) / sizeof(samples[0]));
+	int fails = 0;
+	double t[4] = {0};
+
+	for(int i = 0; i < count; i++)
+	{
+		fails += test_file(files[i], SSDV_TYPE_NORMAL, t);
+		fails += test_file(files[i], SSDV_TYPE_NOFEC, t);
+		fails += test_thumb(files[i], jpeg_len);
+	}
+
+	printf("bench encode: %7.2f ms before, %7.2f ms now\n", t[0] * 1e3 / REPS, t[1] * 1e3 / REPS);
+	printf("bench decode: %7.2f ms before, %7.2f ms now\n", t[2] * 1e3 / REPS, t[3] * 1e3 / REPS);
+	return fails ? 1 : 0;
+}
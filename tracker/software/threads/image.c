@@ -15,6 +15,16 @@
 #include "watchdog.h"
 #include "flash.h"
 
+#define SSDV_PARITY_SIZE	175		/* Image ID, packet ID (2), packet count, XOR of 171 bytes */
+#define SSDV_STREAM_RING	(8*DMA_SEGMENT_SIZE)	/* Camera DMA ring at the end of ram_buffer (streaming mode) */
+#define SSDV_APRS_FRAME_LEN	236		/* AX.25 frame of an APRS/SSDV packet without path (bytes) */
+#define SSDV_AUTO_MIN_QUALITY	2	/* Lowest SSDV quality chosen by RES_AUTO */
+#define SSDV_APRS_FLUSH_BITS	(RADIO_BUFFER_SIZE * 8 - 3 * AX25_MAX_FRAME_BITS)	/* Bits after which the packets are transmitted (room for image, redundant and parity frame) */
+#define SSDV_CHUNKS			32		/* Chunks of packets in progressive order (power of 2) */
+
+/* Camera quantization scale closest to the DQT of each SSDV quality (ssdv_conf.match_dqt) */
+static const uint8_t camera_qs[8] = {63, 14, 7, 5, OV5640_DEFAULT_QS, 2, 1, 1};
+
 const uint8_t noCameraFound[4071] = {
 	0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 0x4A, 0x46, 0x49, 0x46, 0x00, 0x01, 0x01, 0x01, 0x00, 0x48,
 	0x00, 0x48, 0x00, 0x00, 0xFF, 0xDB, 0x00, 0x43, 0x00, 0x10, 0x0B, 0x0C, 0x0E, 0x0C, 0x0A, 0x10,
@@ -283,46 +293,183 @@ bool camera_mtx_init = false;
   */
 static void flush_ssdv_buffer(prot_t protocol, ax25_t *ax25_handle, radioMSG_t *msg)
 {
+	if(msg->buffer == NULL) // Already flushed
+		return;
+
 	switch(protocol) {
 		case PROT_APRS_2GFSK:
 		case PROT_APRS_AFSK:
-			if(protocol == PROT_APRS_2GFSK || protocol == PROT_APRS_AFSK)
+			if(protocol == PROT_APRS_2GFSK || protocol == PROT_APRS_AFSK) {
 				msg->bin_len = aprs_encode_finalize(ax25_handle);
+				msg->preamble_len = ax25_handle->preamble;
+			}
 
-			transmitOnRadio(msg, false);
+			transmitOnRadio(msg, 0);
 			break;
 
 		case PROT_SSDV_2FSK:
-			transmitOnRadio(msg, false);
+			transmitOnRadio(msg, 0);
 			msg->bin_len = 0;
 			break;
 
-		default: break;
+		default:
+			releaseRadioBuffer(msg->buffer);
+			break;
+	}
+	msg->buffer = NULL; // Buffer is owned by the radio now
+}
+
+/**
+  * Encodes the parity packet of an SSDV packet group (APRS only). It contains
+  * the image ID, the ID of the first packet of the group, the amount of
+  * packets and the XOR of the packets (image ID and packet ID excluded). The
+  * decoder is able to restore one lost packet per group.
+  */
+static void encode_ssdv_parity(ax25_t *ax25_handle, module_conf_t* conf, uint8_t *parity, uint8_t *pkt_base91)
+{
+	if(!parity[3]) // Empty group
+		return;
+
+	TRACE_INFO("IMG  > Encode APRS/SSDV parity packet (%d packets)", parity[3]);
+	base91_encode(parity, pkt_base91, SSDV_PARITY_SIZE);
+	aprs_encode_data_packet(ax25_handle, 'P', &conf->aprs_conf, pkt_base91, strlen((char*)pkt_base91));
+	parity[3] = 0;
+}
+
+/**
+  * Progressive transmission (ssdv_conf.progressive). The packets are split into
+  * up to SSDV_CHUNKS chunks of consecutive packets which are transmitted in
+  * bit-reversed order (0, 16, 8, 24, 4, ...), so the received packets of an
+  * interrupted transmission are spread over the whole image. The packet IDs
+  * keep the raster order, the decoder sorts the packets by their ID.
+  */
+typedef struct {
+	ssdv_pos_t pos[SSDV_CHUNKS];	// Encoder position at the start of each chunk
+	uint16_t size;					// Packets per chunk (pre-encoded packets only)
+	uint8_t chunks;					// Amount of chunks (0: raster order)
+	uint8_t seq;					// Chunks started so far
+	uint16_t end;					// Packet ID of the chunk following the current one
+} progressive_t;
+
+/**
+  * Encodes the image once without transmitting it and saves the encoder
+  * position at the start of each chunk. The chunk size starts at one packet
+  * and doubles whenever the table is full, the positions in between are
+  * dropped. Returns the amount of chunks (0 if the image can't be encoded).
+  */
+static uint8_t index_ssdv(ssdv_t *ssdv, const uint8_t *image, uint32_t image_len, ssdv_pos_t *pos)
+{
+	uint16_t size = 1;
+	uint8_t chunks = 0;
+	uint32_t bi = 0;
+	uint8_t c;
+
+	do {
+		if(ssdv->packet_id % size == 0) {
+			if(chunks == SSDV_CHUNKS) { // Table full, merge two chunks each
+				for(uint8_t i=0; i<SSDV_CHUNKS/2; i++)
+					pos[i] = pos[2*i];
+				chunks = SSDV_CHUNKS/2;
+				size *= 2;
+			}
+			if(ssdv->packet_id % size == 0)
+				ssdv_enc_get_pos(ssdv, &pos[chunks++]);
+		}
+
+		while((c = ssdv_enc_get_packet(ssdv)) == SSDV_FEED_ME)
+		{
+			uint32_t r = image_len - bi < 128 ? image_len - bi : 128;
+			if(!r)
+				return 0; // Premature end of file
+			ssdv_enc_feed(ssdv, &image[bi], r);
+			bi += r;
+		}
+	} while(c == SSDV_OK);
+
+	if(c != SSDV_EOI)
+		return 0;
+	if(pos[chunks-1].packet_id == ssdv->packet_id) // Chunk behind the last packet
+		chunks--;
+
+	TRACE_INFO("IMG  > Progressive order: %d chunks of %d packets", chunks, size);
+	return chunks;
+}
+
+/**
+  * Continues with the next chunk in progressive order. The image has to be
+  * fed to the encoder from bi on (or the packets taken from bi if they are
+  * pre-encoded). Returns false if all chunks have been transmitted.
+  */
+static bool next_chunk(progressive_t *prog, ssdv_t *ssdv, uint32_t *bi, bool encoded)
+{
+	uint8_t chunk = SSDV_CHUNKS;
+	while(chunk >= prog->chunks) {
+		if(prog->seq == SSDV_CHUNKS)
+			return false;
+		chunk = 0;
+		for(uint8_t b=1; b<SSDV_CHUNKS; b<<=1) // Bit-reversed sequence number
+			chunk = (chunk << 1) | (prog->seq & b ? 1 : 0);
+		prog->seq++;
+	}
+
+	if(encoded) {
+		*bi = chunk * prog->size * SSDV_PKT_SIZE;
+		prog->end = (chunk + 1) * prog->size;
+	} else {
+		ssdv_enc_set_pos(ssdv, &prog->pos[chunk]);
+		*bi = prog->pos[chunk].in_offset;
+		prog->end = chunk + 1 < prog->chunks ? prog->pos[chunk + 1].packet_id : 0xFFFF;
 	}
+	return true;
 }
 
-void encode_ssdv(const uint8_t *image, uint32_t image_len, module_conf_t* conf, uint8_t image_id, bool redudantTx)
+/**
+  * Encodes and transmits an image. If encoded is set, image holds the SSDV
+  * packets which have been encoded while streaming the image from the camera.
+  * Returns the amount of SSDV packets transmitted.
+  */
+uint16_t encode_ssdv(const uint8_t *image, uint32_t image_len, module_conf_t* conf, uint8_t image_id, uint8_t quality, bool redudantTx, bool encoded)
 {
 	ssdv_t ssdv;
 	uint8_t pkt[SSDV_PKT_SIZE];
 	uint8_t pkt_base91[256];
+	uint8_t parity[SSDV_PARITY_SIZE];
 	const uint8_t *b;
 	uint32_t bi = 0;
 	uint8_t c = SSDV_OK;
 	uint16_t i = 0;
+	parity[3] = 0;
 
 	// Init SSDV (FEC at 2FSK, non FEC at APRS)
 	bi = 0;
-	ssdv_enc_init(&ssdv, conf->protocol == PROT_SSDV_2FSK ? SSDV_TYPE_NORMAL : SSDV_TYPE_PADDING, conf->ssdv_conf.callsign, image_id, conf->ssdv_conf.quality);
+	ssdv_enc_init(&ssdv, conf->protocol == PROT_SSDV_2FSK ? SSDV_TYPE_NORMAL : SSDV_TYPE_PADDING, conf->ssdv_conf.callsign, image_id, quality);
 	ssdv_enc_set_buffer(&ssdv, pkt);
 
+	// Progressive order (the chunks of pre-encoded packets are found without indexing)
+	progressive_t prog;
+	prog.chunks = 0;
+	prog.seq = 0;
+	prog.end = 0;
+	if(conf->ssdv_conf.progressive && encoded) {
+		uint16_t n = image_len / SSDV_PKT_SIZE;
+		prog.size = n > SSDV_CHUNKS ? (n + SSDV_CHUNKS - 1) / SSDV_CHUNKS : 1;
+		prog.chunks = (n + prog.size - 1) / prog.size;
+	} else if(conf->ssdv_conf.progressive) {
+		prog.chunks = index_ssdv(&ssdv, image, image_len, prog.pos);
+		if(!prog.chunks) // Transmit in raster order, the error shows up again
+			ssdv_enc_init(&ssdv, conf->protocol == PROT_SSDV_2FSK ? SSDV_TYPE_NORMAL : SSDV_TYPE_PADDING, conf->ssdv_conf.callsign, image_id, quality);
+	}
+
 	// Init transmission packet
 	radioMSG_t msg;
-	uint8_t buffer[conf->packet_spacing ? 2048 : 8192];
-	msg.buffer = buffer;
+	uint16_t buffer_size = conf->packet_spacing ? 2048 : RADIO_BUFFER_SIZE;
+	msg.buffer = getImageRadioBuffer();
 	msg.bin_len = 0;
 	msg.freq = &conf->frequency;
 	msg.power = conf->power;
+	msg.priority = conf->tx_priority;
+	msg.deadline = conf->tx_deadline;
+	msg.preamble_len = 0;
 
 	ax25_t ax25_handle;
 	if(conf->protocol == PROT_APRS_2GFSK || conf->protocol == PROT_APRS_AFSK)
@@ -330,14 +477,39 @@ void encode_ssdv(const uint8_t *image, uint32_t image_len, module_conf_t* conf,
 		msg.mod = conf->protocol == PROT_APRS_AFSK ? MOD_AFSK : MOD_2GFSK;
 		msg.afsk_conf = &(conf->afsk_conf);
 		msg.gfsk_conf = &(conf->gfsk_conf);
-		aprs_encode_init(&ax25_handle, buffer, sizeof(buffer), msg.mod);
+		aprs_encode_init(&ax25_handle, msg.buffer, buffer_size, msg.mod);
 	}
 
 	while(true)
 	{
 		conf->wdg_timeout = chVTGetSystemTimeX() + S2ST(600); // TODO: Implement more sophisticated method
 
-		while((c = ssdv_enc_get_packet(&ssdv)) == SSDV_FEED_ME)
+		// Get new buffer if the last one has been handed over to the radio
+		if(msg.buffer == NULL) {
+			msg.buffer = getImageRadioBuffer();
+			msg.bin_len = 0;
+			if(conf->protocol == PROT_APRS_2GFSK || conf->protocol == PROT_APRS_AFSK)
+				aprs_encode_init(&ax25_handle, msg.buffer, buffer_size, msg.mod);
+		}
+
+		// Progressive order: Continue with the next chunk at the end of the current one
+		bool last = false;
+		if(prog.chunks && (encoded ? bi / SSDV_PKT_SIZE : ssdv.packet_id) >= prog.end) {
+			encode_ssdv_parity(&ax25_handle, conf, parity, pkt_base91); // Parity groups don't span chunks
+			last = !next_chunk(&prog, &ssdv, &bi, encoded);
+		}
+
+		if(last) {
+			c = SSDV_EOI;
+		} else if(encoded) { // Take packet from the image
+			if(bi + SSDV_PKT_SIZE <= image_len) {
+				memcpy(pkt, &image[bi], SSDV_PKT_SIZE);
+				bi += SSDV_PKT_SIZE;
+				c = SSDV_OK;
+			} else {
+				c = SSDV_EOI;
+			}
+		} else while((c = ssdv_enc_get_packet(&ssdv)) == SSDV_FEED_ME)
 		{
 			b = &image[bi];
 			uint8_t r = bi < image_len-128 ? 128 : image_len - bi;
@@ -346,21 +518,29 @@ void encode_ssdv(const uint8_t *image, uint32_t image_len, module_conf_t* conf,
 			if(r <= 0)
 			{
 				TRACE_ERROR("SSDV > Premature end of file");
+				encode_ssdv_parity(&ax25_handle, conf, parity, pkt_base91);
 				flush_ssdv_buffer(conf->protocol, &ax25_handle, &msg);
 				break;
 			}
 			ssdv_enc_feed(&ssdv, b, r);
 		}
 
+		if(c == SSDV_EOI && prog.chunks && !last)
+		{
+			prog.end = 0; // End of the image data, not of the transmission
+			continue;
+		}
+
 		if(c == SSDV_EOI)
 		{
 			TRACE_INFO("SSDV > ssdv_enc_get_packet said EOI");
+			encode_ssdv_parity(&ax25_handle, conf, parity, pkt_base91);
 			flush_ssdv_buffer(conf->protocol, &ax25_handle, &msg);
 			break;
 		} else if(c != SSDV_OK) {
 			TRACE_ERROR("SSDV > ssdv_enc_get_packet failed: %i", c);
 			flush_ssdv_buffer(conf->protocol, &ax25_handle, &msg);
-			return;
+			return i;
 		}
 
 		switch(conf->protocol) {
@@ -376,16 +556,25 @@ void encode_ssdv(const uint8_t *image, uint32_t image_len, module_conf_t* conf,
 				if(redudantTx)
 					aprs_encode_data_packet(&ax25_handle, 'I', &conf->aprs_conf, pkt_base91, strlen((char*)pkt_base91));
 
-				// Transmit if buffer is almost full or if single packet transmission is activated (packet_spacing != 0)
+				// Add packet to parity packet, which is sent after the last packet of the group
+				if(conf->ssdv_conf.parity_group) {
+					if(!parity[3]) {
+						memcpy(parity, &pkt[6], 3); // Image ID, packet ID
+						memset(&parity[4], 0, SSDV_PARITY_SIZE-4);
+					}
+					for(uint8_t j=0; j<SSDV_PARITY_SIZE-4; j++)
+						parity[4+j] ^= pkt[9+j];
+					if(++parity[3] >= conf->ssdv_conf.parity_group)
+						encode_ssdv_parity(&ax25_handle, conf, parity, pkt_base91);
+				}
+
+				// Transmit if the next packet might not fit anymore or if single packet transmission is activated (packet_spacing != 0)
 				// or if AFSK is selected (because the encoding takes a lot of buffer)
-				if(ax25_handle.size >= 58000 || conf->packet_spacing || conf->protocol == PROT_APRS_AFSK)
+				if(ax25_handle.size + 3 * AX25_MAX_FRAME_BITS > ax25_handle.max_bits || conf->packet_spacing || conf->protocol == PROT_APRS_AFSK)
 				{
 					// Transmit packets
 					flush_ssdv_buffer(conf->protocol, &ax25_handle, &msg);
 
-					// Initialize new packet buffer
-					aprs_encode_init(&ax25_handle, buffer, sizeof(buffer), msg.mod);
-
 					if(!conf->packet_spacing)
 						chThdSleepMilliseconds(6000);
 				}
@@ -423,65 +612,363 @@ void encode_ssdv(const uint8_t *image, uint32_t image_len, module_conf_t* conf,
 
 		i++;
 	}
+
+	return i;
 }
 
 /**
-  * Analyzes the image for JPEG errors. Returns true if the image is error free.
+  * Scores an image from 0 (useless) to 100 using the luminance block means
+  * collected by the SSDV encoder. Exposure is rated by the mean brightness,
+  * contrast by the spread of the block means (low for darkness or plain sky)
+  * and detail by the JPEG size per pixel.
   */
-static bool analyze_image(uint8_t *image, uint32_t image_len)
+static uint8_t image_score(ssdv_t *ssdv, uint32_t jpeg_len)
 {
-	return true;
-	#if !OV5640_USE_DMA_DBM
-	if(image_len >= 65535)
+	if(!ssdv->dc_count || !ssdv->width || !ssdv->height)
+		return 0;
+
+	int32_t mean = ssdv->dc_sum / (int32_t)ssdv->dc_count;
+	int32_t var = ssdv->dc_sqsum / ssdv->dc_count - mean * mean;
+	uint32_t spread = 0; // Standard deviation (integer square root, var is at most 128^2)
+	while(var > 0 && (spread + 1) * (spread + 1) <= (uint32_t)var)
+		spread++;
+	mean += 128; // Luminance 0-255
+
+	uint32_t exposure = mean < 16 || mean > 240 ? 0
+	                  : mean < 64 ? (mean - 16) * 100 / 48
+	                  : mean > 192 ? (240 - mean) * 100 / 48 : 100;
+	uint32_t contrast = spread >= 32 ? 100 : spread * 100 / 32;
+	uint32_t detail = jpeg_len * 1000 / (ssdv->width * ssdv->height); // 100 at 0.1 bytes per pixel
+	if(detail > 100)
+		detail = 100;
+
+	TRACE_INFO("IMG  > Score: brightness %d spread %d size %d bytes light %d", mean, spread, jpeg_len, OV5640_getLastLightIntensity());
+	return exposure * (contrast + detail) / 200;
+}
+
+/**
+  * Scores a sampled JPEG image by running the SSDV encoder over it
+  */
+static uint8_t score_jpeg(const uint8_t *image, uint32_t image_len, uint8_t quality)
+{
+	ssdv_t ssdv;
+	uint8_t pkt[SSDV_PKT_SIZE];
+	uint32_t bi = 0;
+	uint8_t c;
+
+	ssdv_enc_init(&ssdv, SSDV_TYPE_NOFEC, "", 0, quality);
+	ssdv_enc_set_buffer(&ssdv, pkt);
+
+	while(true)
 	{
-		TRACE_ERROR("CAM  > Camera has %d bytes allocated but DMA DBM not activated", image_len);
-		TRACE_ERROR("CAM  > DMA can only use 65535 bytes only");
-		image_len = 65535;
+		while((c = ssdv_enc_get_packet(&ssdv)) == SSDV_FEED_ME)
+		{
+			uint32_t r = image_len - bi < 128 ? image_len - bi : 128;
+			if(!r)
+				return 0; // Premature end of file
+			ssdv_enc_feed(&ssdv, &image[bi], r);
+			bi += r;
+		}
+
+		if(c == SSDV_EOI)
+			return image_score(&ssdv, image_len);
+		if(c != SSDV_OK)
+			return 0;
 	}
-	#endif
+}
 
+/**
+  * Downscales the sampled JPEG image to ssdv_conf.thumbnail/8 of its size in
+  * the DCT domain (one pixel per block from the DC coefficient at 1/8 scale,
+  * the low order AC coefficients are used at 1/4 and 1/2). The pixel planes
+  * and the thumbnail JPEG are written into ram_buffer behind the image.
+  * Returns the size of the thumbnail JPEG (0 if it could not be created).
+  */
+static uint32_t thumbnail_jpeg(ssdv_conf_t *sconf, uint8_t **thumb)
+{
 	ssdv_t ssdv;
 	uint8_t pkt[SSDV_PKT_SIZE];
-	uint8_t *b;
+	uint32_t start = (sconf->size_sampled + 31) & ~31;
 	uint32_t bi = 0;
-	uint16_t i = 0;
-	uint8_t c = SSDV_OK;
+	uint8_t c;
 
-	ssdv_enc_init(&ssdv, SSDV_TYPE_NOFEC, "", 0, 7);
+	if(start >= sconf->ram_size)
+		return 0;
+
+	ssdv_enc_init(&ssdv, SSDV_TYPE_NOFEC, "", 0, sconf->quality);
 	ssdv_enc_set_buffer(&ssdv, pkt);
+	if(ssdv_enc_set_thumb(&ssdv, sconf->thumbnail, &sconf->ram_buffer[start], sconf->ram_size - start) != SSDV_OK)
+		return 0;
 
-	while(true) // FIXME: I get caught in these loops occasionally and never return
-	{
+	do {
 		while((c = ssdv_enc_get_packet(&ssdv)) == SSDV_FEED_ME)
 		{
-			b = &image[bi];
-			uint8_t r = bi < image_len-128 ? 128 : image_len - bi;
+			uint32_t r = sconf->size_sampled - bi < 128 ? sconf->size_sampled - bi : 128;
+			if(!r)
+				return 0; // Premature end of file
+			ssdv_enc_feed(&ssdv, &sconf->ram_buffer[bi], r);
 			bi += r;
-			if(r <= 0)
-			{
-				TRACE_ERROR("CAM  > Error in image (Premature end of file %d)", i);
+		}
+		if(c != SSDV_OK && c != SSDV_EOI)
+			return 0;
+	} while(c != SSDV_EOI);
+
+	// The JPEG follows the planes (upper bound of their size at 4:4:4 sampling)
+	uint32_t planes = 3 * (ssdv.width / 8 * sconf->thumbnail) * (ssdv.height / 8 * sconf->thumbnail);
+	if(start + planes >= sconf->ram_size)
+		return 0;
+	size_t len = sconf->ram_size - start - planes;
+	*thumb = &sconf->ram_buffer[start + planes];
+	if(ssdv_thumb_get_jpeg(&ssdv, sconf->quality, *thumb, &len) != SSDV_OK)
+		return 0;
+
+	TRACE_INFO("IMG  > Thumbnail %dx%d (%d bytes)", ssdv.width, ssdv.height, len);
+	return len;
+}
+
+/**
+  * Analyzes the image for JPEG errors. Returns true if the image is error free.
+  * Walks the markers and checks the segment lengths, the tables referenced by
+  * SOF and SOS and the entropy coded data for illegal markers. Every byte is
+  * visited once, so the check takes a few milliseconds only.
+  */
+static bool analyze_image(uint8_t *image, uint32_t image_len)
+{
+	uint32_t i = 2;
+	uint8_t dqt = 0, dht_dc = 0, dht_ac = 0;	// Defined tables (bit masks)
+	uint8_t comp_id[4], comp_tq[4], comps = 0;	// Components of SOF
+	bool sos = false;
+
+	if(image_len < 4 || image[0] != 0xFF || image[1] != 0xD8) {
+		TRACE_ERROR("CAM  > Error in image (No SOI)");
+		return false;
+	}
+
+	while(i+1 < image_len)
+	{
+		if(image[i] != 0xFF) {
+			TRACE_ERROR("CAM  > Error in image (Marker expected at %d)", i);
+			return false;
+		}
+		uint8_t m = image[i+1];
+		i += 2;
+		if(m == 0xFF) { // Fill byte
+			i--;
+			continue;
+		}
+		if(m == 0xD9) { // EOI
+			if(!sos) {
+				TRACE_ERROR("CAM  > Error in image (EOI before SOS)");
 				return false;
 			}
-			ssdv_enc_feed(&ssdv, b, r);
+			return true;
+		}
+		if(m == 0xD8 || m == 0x00 || (m >= 0xD0 && m <= 0xD7)) { // SOI, stuffing or RST outside of scan
+			TRACE_ERROR("CAM  > Error in image (Marker %02x at %d)", m, i-2);
+			return false;
 		}
 
-		if(c == SSDV_EOI) // End of image
-			return true;
+		// All other markers have a segment length
+		if(i+2 > image_len) {
+			TRACE_ERROR("CAM  > Error in image (Premature end of file)");
+			return false;
+		}
+		uint16_t len = (image[i] << 8) | image[i+1];
+		if(len < 2 || i+len > image_len) {
+			TRACE_ERROR("CAM  > Error in image (Invalid length %d of marker %02x)", len, m);
+			return false;
+		}
+		const uint8_t *seg = &image[i+2];
+		len -= 2;
 
-		if(c != SSDV_OK) // Error in JPEG image
+		switch(m)
 		{
-			TRACE_ERROR("CAM  > Error in image (ssdv_enc_get_packet failed: %d %d)", c, i);
-			return false;
+			case 0xDB: // DQT
+				for(uint16_t j=0; j<len; j+=1+((seg[j] >> 4) ? 128 : 64)) {
+					if((seg[j] & 0xF) > 3 || j+1+((seg[j] >> 4) ? 128 : 64) > len) {
+						TRACE_ERROR("CAM  > Error in image (Invalid DQT)");
+						return false;
+					}
+					dqt |= 1 << (seg[j] & 0xF);
+				}
+				break;
+
+			case 0xC4: // DHT
+				for(uint16_t j=0; j<len;) {
+					uint16_t n = 0;
+					if((seg[j] & 0xF) > 3 || (seg[j] >> 4) > 1 || j+17 > len) {
+						TRACE_ERROR("CAM  > Error in image (Invalid DHT)");
+						return false;
+					}
+					for(uint8_t k=1; k<=16; k++)
+						n += seg[j+k];
+					if(n > 256 || j+17+n > len) {
+						TRACE_ERROR("CAM  > Error in image (Invalid DHT)");
+						return false;
+					}
+					if(seg[j] >> 4)
+						dht_ac |= 1 << (seg[j] & 0xF);
+					else
+						dht_dc |= 1 << (seg[j] & 0xF);
+					j += 17+n;
+				}
+				break;
+
+			case 0xC0: // SOF0 (Baseline)
+			case 0xC1: // SOF1 (Extended sequential)
+				comps = len >= 6 ? seg[5] : 0;
+				if(comps == 0 || comps > 4 || len != 6+3*comps || seg[0] != 8
+					|| !((seg[1] << 8) | seg[2]) || !((seg[3] << 8) | seg[4])) {
+					TRACE_ERROR("CAM  > Error in image (Invalid SOF)");
+					return false;
+				}
+				for(uint8_t k=0; k<comps; k++) {
+					comp_id[k] = seg[6+3*k];
+					comp_tq[k] = seg[8+3*k];
+					if(!seg[7+3*k] || comp_tq[k] > 3) {
+						TRACE_ERROR("CAM  > Error in image (Invalid SOF)");
+						return false;
+					}
+				}
+				break;
+
+			case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+			case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+				TRACE_ERROR("CAM  > Error in image (Unsupported SOF %02x)", m);
+				return false;
+
+			case 0xDD: // DRI
+				if(len != 2) {
+					TRACE_ERROR("CAM  > Error in image (Invalid DRI)");
+					return false;
+				}
+				break;
+
+			case 0xDA: // SOS
+				if(!comps || len < 1 || !seg[0] || seg[0] > comps || len != 4+2*seg[0]) {
+					TRACE_ERROR("CAM  > Error in image (Invalid SOS)");
+					return false;
+				}
+				for(uint8_t k=0; k<seg[0]; k++) {
+					uint8_t c;
+					for(c=0; c<comps && comp_id[c] != seg[1+2*k]; c++);
+					if(c == comps || !(dqt & (1 << comp_tq[c]))
+						|| (seg[2+2*k] >> 4) > 3 || !(dht_dc & (1 << (seg[2+2*k] >> 4)))
+						|| (seg[2+2*k] & 0xF) > 3 || !(dht_ac & (1 << (seg[2+2*k] & 0xF)))) {
+						TRACE_ERROR("CAM  > Error in image (SOS references undefined table)");
+						return false;
+					}
+				}
+				sos = true;
+
+				// Entropy coded data until next marker (only stuffing and RST allowed)
+				i += len+2;
+				for(uint8_t rst = 0; i+1 < image_len; i++) {
+					if(image[i] != 0xFF)
+						continue;
+					if(image[i+1] == 0x00) {
+						i++;
+					} else if(image[i+1] >= 0xD0 && image[i+1] <= 0xD7) {
+						if(image[i+1] != 0xD0 + rst) {
+							TRACE_ERROR("CAM  > Error in image (RST out of sequence at %d)", i);
+							return false;
+						}
+						rst = (rst+1) & 7;
+						i++;
+					} else if(image[i+1] != 0xFF) {
+						break; // Marker
+					}
+				}
+				continue;
+
+			default: // APPn, COM and others are skipped
+				break;
 		}
 
-		i++;
-		chThdSleepMilliseconds(5);
+		i += len+2;
 	}
+
+	TRACE_ERROR("CAM  > Error in image (Premature end of file)");
+	return false;
 }
 
+#if OV5640_USE_DMA_DBM == TRUE
+/**
+  * Samples an image and encodes it to SSDV (using the protocol of conf) while
+  * the camera is still sampling. The camera writes into a ring of
+  * SSDV_STREAM_RING bytes at the end of sconf->ram_buffer, the SSDV packets
+  * are stored at its beginning. Returns the size
+  * of the packets, 0 if the image could not be sampled or encoded.
+  */
+static uint32_t stream_ssdv(module_conf_t* conf, ssdv_conf_t *sconf, uint8_t image_id)
+{
+	uint32_t store_size = (sconf->ram_size - SSDV_STREAM_RING) & ~(DMA_FIFO_BURST_ALIGN-1);
+	uint8_t *ring = &sconf->ram_buffer[store_size];
+	uint32_t size = 0;
+	uint32_t jpeg_len = 0;
+	const uint8_t *b;
+	uint32_t r;
+	uint8_t c;
+	ssdv_t ssdv;
+
+	if(sconf->ram_size < SSDV_STREAM_RING + SSDV_PKT_SIZE) {
+		TRACE_ERROR("CAM  > Buffer too small for streaming");
+		return 0;
+	}
+
+	ssdv_enc_init(&ssdv, conf->protocol == PROT_SSDV_2FSK ? SSDV_TYPE_NORMAL : SSDV_TYPE_PADDING, sconf->callsign, image_id, sconf->quality);
+	ssdv_enc_set_buffer(&ssdv, sconf->ram_buffer);
+
+	if(!OV5640_StreamStart(ring, SSDV_STREAM_RING, sconf->res))
+		return 0;
+
+	// Encode segments as soon as the DMA has completed them
+	while(true)
+	{
+		while((c = ssdv_enc_get_packet(&ssdv)) == SSDV_FEED_ME)
+		{
+			if(!(r = OV5640_StreamRead(&b)))
+				break;
+			ssdv_enc_feed(&ssdv, b, r);
+			jpeg_len += r;
+		}
+
+		if(c != SSDV_OK)
+			break;
+
+		// Packet complete, next packet behind it
+		size += SSDV_PKT_SIZE;
+		if(size + SSDV_PKT_SIZE > store_size) {
+			TRACE_ERROR("CAM  > Image too large for buffer (%d bytes)", store_size);
+			break;
+		}
+		ssdv_enc_set_buffer(&ssdv, &sconf->ram_buffer[size]);
+	}
+
+	bool status = OV5640_StreamStop();
+
+	if(c == SSDV_FEED_ME) {
+		TRACE_ERROR("CAM  > Error in image (Premature end of file)");
+	} else if(c != SSDV_EOI && c != SSDV_OK) {
+		TRACE_ERROR("CAM  > Error in image (ssdv_enc_get_packet failed: %d)", c);
+	}
+	if(!status || c != SSDV_EOI)
+		return 0;
+
+	TRACE_INFO("CAM  > Encoded %d SSDV packets while streaming", size / SSDV_PKT_SIZE);
+	sconf->score = image_score(&ssdv, jpeg_len);
+	return size;
+}
+#endif
+
 static bool camInitialized = false;
 
-bool takePicture(ssdv_conf_t *conf, bool enableJpegValidation)
+/**
+  * Samples an image into conf->ram_buffer. If stream_conf is set, the image is
+  * encoded to SSDV while sampling and ram_buffer holds the packets of image
+  * image_id.
+  */
+static bool samplePicture(ssdv_conf_t *conf, bool enableJpegValidation, module_conf_t* stream_conf, uint8_t image_id)
 {
 	bool camera_found = false;
 
@@ -500,9 +987,7 @@ bool takePicture(ssdv_conf_t *conf, bool enableJpegValidation)
 		TRACE_INFO("IMG  > OV5640 found");
 		camera_found = true;
 
-		// Lock Radio (The radio uses the same DMA for SPI as the camera)
-		lockRadioByCamera(); // Lock radio
-
+		// The radio is locked by the camera driver while the DMA samples (not while streaming)
 		uint8_t cntr = 5;
 		bool jpegValid;
 		do {
@@ -512,8 +997,22 @@ bool takePicture(ssdv_conf_t *conf, bool enableJpegValidation)
 				camInitialized = true;
 			}
 
-			// Sample data from pseudo DCMI through DMA into RAM
-			conf->size_sampled = OV5640_Snapshot2RAM(conf->ram_buffer, conf->ram_size, conf->res);
+			// JPEG quantization (SSDV copies the coefficients if the tables match)
+			OV5640_SetQuantization(conf->match_dqt ? camera_qs[conf->quality] : OV5640_DEFAULT_QS);
+
+			if(stream_conf) {
+#if OV5640_USE_DMA_DBM == TRUE
+				// Sample data and encode it to SSDV at the same time
+				conf->size_sampled = stream_ssdv(stream_conf, conf, image_id);
+#else
+				TRACE_ERROR("CAM  > Streaming requires OV5640_USE_DMA_DBM");
+				conf->size_sampled = 0;
+				cntr = 0;
+#endif
+			} else {
+				// Sample data from pseudo DCMI through DMA into RAM
+				conf->size_sampled = OV5640_Snapshot2RAM(conf->ram_buffer, conf->ram_size, conf->res);
+			}
 
 			// Switch off camera
 			if(!keep_cam_switched_on) {
@@ -522,19 +1021,20 @@ bool takePicture(ssdv_conf_t *conf, bool enableJpegValidation)
 			}
 
 			// Validate JPEG image
-			if(enableJpegValidation)
+			if(stream_conf)
+			{
+				jpegValid = conf->size_sampled > 0; // Validated by the SSDV encoder
+			}
+			else if(enableJpegValidation)
 			{
 				TRACE_INFO("CAM  > Validate integrity of JPEG");
-				jpegValid = analyze_image(conf->ram_buffer, conf->ram_size);
+				jpegValid = conf->size_sampled && analyze_image(conf->ram_buffer, conf->size_sampled);
 				TRACE_INFO("CAM  > JPEG image %s", jpegValid ? "valid" : "invalid");
 			} else {
 				jpegValid = true;
 			}
 		} while(!jpegValid && cntr--);
 
-		// Unlock radio
-		unlockRadio();
-
 	} else { // Camera not found
 
 		camInitialized = false;
@@ -549,6 +1049,261 @@ bool takePicture(ssdv_conf_t *conf, bool enableJpegValidation)
 	return camera_found;
 }
 
+bool takePicture(ssdv_conf_t *conf, bool enableJpegValidation)
+{
+	return samplePicture(conf, enableJpegValidation, NULL, 0);
+}
+
+/**
+  * Sizes of recent images of an image thread, used to choose the resolution
+  * and quality at RES_AUTO and RES_MAX (0: no image taken yet)
+  */
+typedef struct {
+	uint16_t packets[RES_UXGA+1][8];	// SSDV packets per resolution and quality
+	uint32_t jpeg[RES_UXGA+1];			// Size of the camera JPEG per resolution
+} image_stats_t;
+
+static const uint32_t res_pixels[RES_UXGA+1] = {160*120, 320*240, 640*480, 1024*768, 1600*1200};
+
+/* SSDV image size per quality in percent of quality 4 (measured at test images) */
+static const uint16_t quality_size[8] = {22, 46, 91, 98, 100, 131, 169, 253};
+
+/**
+  * Adds a measurement to the statistics (moving average over ~4 images)
+  */
+static void record_size(uint32_t *avg, uint32_t size)
+{
+	*avg = *avg ? (3 * *avg + size) / 4 : size;
+}
+
+/**
+  * Estimates the SSDV packets of an image. Unknown combinations are derived
+  * from the closest known one by scaling with pixels and quality.
+  */
+static uint32_t estimate_packets(image_stats_t *stats, resolution_t res, uint8_t quality)
+{
+	uint32_t best = 0xFFFFFFFF;
+	uint32_t est = 200 * res_pixels[res] / res_pixels[RES_VGA] * quality_size[quality] / 100; // Default VGA quality 4
+	for(uint8_t r=RES_QQVGA; r<=RES_UXGA; r++)
+		for(uint8_t q=0; q<8; q++) {
+			uint32_t dist = 8*(r > res ? r - res : res - r) + (q > quality ? q - quality : quality - q);
+			if(stats->packets[r][q] && dist < best) {
+				best = dist;
+				est = (uint64_t)stats->packets[r][q] * res_pixels[res] / res_pixels[r] * quality_size[quality] / quality_size[q];
+			}
+		}
+	return est;
+}
+
+/**
+  * Estimates the size of the camera JPEG image
+  */
+static uint32_t estimate_jpeg(image_stats_t *stats, resolution_t res)
+{
+	uint32_t best = 0xFFFFFFFF;
+	uint32_t est = res_pixels[res] / 8; // Default 0.125 bytes per pixel
+	for(uint8_t r=RES_QQVGA; r<=RES_UXGA; r++) {
+		uint32_t dist = r > res ? r - res : res - r;
+		if(stats->jpeg[r] && dist < best) {
+			best = dist;
+			est = (uint64_t)stats->jpeg[r] * res_pixels[res] / res_pixels[r];
+		}
+	}
+	return est;
+}
+
+/**
+  * Returns the time needed to transmit one SSDV packet in milliseconds
+  */
+static uint32_t ssdv_packet_time(module_conf_t *conf)
+{
+	uint32_t bits, baud, ms;
+
+	switch(conf->protocol) {
+		case PROT_APRS_AFSK:
+		case PROT_APRS_2GFSK:
+			baud = conf->protocol == PROT_APRS_AFSK ? 1200 : conf->gfsk_conf.speed;
+			bits = (SSDV_APRS_FRAME_LEN + (conf->aprs_conf.path[0] ? 7 : 0)) * 8 * 21 / 20; // Bit stuffing
+			ms = bits * 1000 / baud;
+			if(conf->ssdv_conf.redundantTx)
+				ms *= 2;
+			if(conf->ssdv_conf.parity_group)
+				ms += ms / conf->ssdv_conf.parity_group;
+			if(conf->packet_spacing || conf->protocol == PROT_APRS_AFSK) // Each packet sent separately
+				ms += conf->aprs_conf.preamble;
+			else // Pause after each full buffer
+				ms += 6000 * bits / SSDV_APRS_FLUSH_BITS;
+			break;
+
+		case PROT_SSDV_2FSK:
+			baud = conf->fsk_conf.baud;
+			bits = SSDV_PKT_SIZE * (1 + conf->fsk_conf.bits + conf->fsk_conf.stopbits);
+			ms = bits * 1000 / baud;
+			if(conf->ssdv_conf.redundantTx)
+				ms *= 2;
+			break;
+
+		default:
+			ms = 0;
+	}
+
+	// Encoding loop sleeps 100ms per packet (plus spacing)
+	return (ms > 100 ? ms : 100) + conf->packet_spacing;
+}
+
+/**
+  * Chooses resolution and quality of the next image at RES_AUTO and RES_MAX.
+  * RES_MAX takes the highest resolution which fits into the buffer. RES_AUTO
+  * additionally reduces the quality (down to SSDV_AUTO_MIN_QUALITY) and the
+  * resolution until the image can be transmitted within ssdv_conf.airtime.
+  * The estimates get 25% headroom since the size depends on the scene.
+  */
+static void choose_resolution(image_stats_t *stats, module_conf_t *conf, ssdv_conf_t *sconf)
+{
+	resolution_t mode = conf->ssdv_conf.res;
+	if(mode != RES_AUTO && mode != RES_MAX)
+		return;
+
+	uint8_t qmax = conf->ssdv_conf.quality;
+	uint8_t qmin = mode == RES_AUTO && qmax > SSDV_AUTO_MIN_QUALITY ? SSDV_AUTO_MIN_QUALITY : qmax;
+	uint32_t budget = mode == RES_AUTO ? conf->ssdv_conf.airtime * 1000 : 0;
+	uint32_t pkt_time = ssdv_packet_time(conf);
+
+	sconf->res = RES_QQVGA;
+	sconf->quality = qmin;
+	for(int8_t r=RES_UXGA; r>=RES_QQVGA; r--) {
+		for(int8_t q=qmax; q>=qmin; q--) {
+			uint32_t packets = estimate_packets(stats, r, q) * 5 / 4;
+			bool fits = sconf->stream ? packets * SSDV_PKT_SIZE + SSDV_STREAM_RING <= sconf->ram_size
+			                          : estimate_jpeg(stats, r) * 5 / 4 + DMA_SEGMENT_SIZE <= sconf->ram_size;
+			if(fits && (!budget || packets * pkt_time <= budget)) {
+				sconf->res = r;
+				sconf->quality = q;
+				r = -1; // Done
+				break;
+			}
+		}
+	}
+
+	TRACE_INFO("IMG  > Chose resolution %d quality %d (%d packets, %d sec estimated)",
+				sconf->res, sconf->quality, estimate_packets(stats, sconf->res, sconf->quality),
+				estimate_packets(stats, sconf->res, sconf->quality) * pkt_time / 1000);
+}
+
+/**
+  * Image of the image thread. In pipelined mode there are two of them, one is
+  * transmitted while the other one is captured.
+  */
+typedef struct {
+	module_conf_t *conf;
+	image_stats_t *stats;
+	ssdv_conf_t ssdv_conf;	// SSDV config of the module with the buffer of this image
+	uint8_t *buffer;		// Buffer of this image (split in two in burst mode)
+	uint32_t size;
+	uint8_t image_id;
+	uint8_t thumb_id;		// Image ID of the thumbnail (ssdv_conf.thumbnail only)
+	bool camera_found;
+	bool streamed;			// ssdv_conf.ram_buffer holds SSDV packets
+	bool skip;				// No frame of the burst reached ssdv_conf.min_score
+} image_job_t;
+
+/**
+  * Takes a frame (encodes it while sampling in streaming mode, takes a normal
+  * picture if streaming fails). The frame is scored in burst mode.
+  */
+static void capture_frame(image_job_t *job, bool burst)
+{
+	job->streamed = false;
+	job->ssdv_conf.score = 0;
+	if(job->ssdv_conf.stream)
+		job->streamed = job->camera_found = samplePicture(&job->ssdv_conf, true, job->conf, job->image_id) && job->ssdv_conf.size_sampled;
+	if(!job->streamed) {
+		job->camera_found = takePicture(&job->ssdv_conf, true);
+		if(job->camera_found && burst)
+			job->ssdv_conf.score = score_jpeg(job->ssdv_conf.ram_buffer, job->ssdv_conf.size_sampled, job->ssdv_conf.quality);
+	}
+
+	if(job->camera_found && !job->streamed && job->ssdv_conf.res <= RES_UXGA)
+		record_size(&job->stats->jpeg[job->ssdv_conf.res], job->ssdv_conf.size_sampled);
+}
+
+/**
+  * Takes a picture. In burst mode ssdv_conf.burst frames are taken into the
+  * two halves of the buffer, the better one is kept while the next frame
+  * overwrites the other half.
+  */
+static void capture_image(image_job_t *job)
+{
+	uint8_t frames = job->ssdv_conf.burst > 1 ? job->ssdv_conf.burst : 1;
+	uint32_t half = (job->size / 2) & ~(DMA_FIFO_BURST_ALIGN-1);
+
+	job->ssdv_conf.ram_buffer = job->buffer;
+	job->ssdv_conf.ram_size = frames > 1 ? half : job->size;
+	choose_resolution(job->stats, job->conf, &job->ssdv_conf);
+
+	job->image_id = gimage_id++; // Increase SSDV image counter
+	if(job->ssdv_conf.thumbnail)
+		job->thumb_id = gimage_id++;
+	job->skip = false;
+	if(frames == 1) {
+		capture_frame(job, false);
+		return;
+	}
+
+	// Burst
+	image_job_t best = *job;
+	best.camera_found = false;
+	for(uint8_t i=0; i<frames; i++) {
+		job->ssdv_conf.ram_buffer = &job->buffer[best.camera_found && best.ssdv_conf.ram_buffer == job->buffer ? half : 0];
+		capture_frame(job, true);
+		if(!job->camera_found)
+			break;
+		TRACE_INFO("IMG  > Burst frame %d/%d score %d", i+1, frames, job->ssdv_conf.score);
+		if(!best.camera_found || job->ssdv_conf.score > best.ssdv_conf.score)
+			best = *job;
+		if(job->conf->wdg_timeout < chVTGetSystemTimeX() + S2ST(60))
+			break; // Don't let the watchdog bite
+	}
+
+	if(best.camera_found) {
+		*job = best;
+		job->skip = job->ssdv_conf.score < job->ssdv_conf.min_score;
+	}
+}
+
+static THD_FUNCTION(captureThread, arg)
+{
+	capture_image((image_job_t*)arg);
+}
+
+static void transmit_image(image_job_t *job)
+{
+	module_conf_t* conf = job->conf;
+
+	if(job->skip) {
+		TRACE_INFO("IMG  > Skip image ID=%d (score %d below %d)", job->image_id, job->ssdv_conf.score, job->ssdv_conf.min_score);
+	} else if(job->camera_found) {
+		// Thumbnail first (downscaled from the same JPEG)
+		uint8_t *thumb;
+		uint32_t thumb_len;
+		if(job->ssdv_conf.thumbnail && !job->streamed && (thumb_len = thumbnail_jpeg(&job->ssdv_conf, &thumb))) {
+			TRACE_INFO("IMG  > Encode/Transmit SSDV thumbnail ID=%d", job->thumb_id);
+			encode_ssdv(thumb, thumb_len, conf, job->thumb_id, job->ssdv_conf.quality, conf->ssdv_conf.redundantTx, false);
+		}
+
+		TRACE_INFO("IMG  > Encode/Transmit SSDV ID=%d", job->image_id);
+		uint16_t packets = encode_ssdv(job->ssdv_conf.ram_buffer, job->ssdv_conf.size_sampled, conf, job->image_id, job->ssdv_conf.quality, conf->ssdv_conf.redundantTx, job->streamed);
+		if(job->ssdv_conf.res <= RES_UXGA && packets) {
+			uint32_t avg = job->stats->packets[job->ssdv_conf.res][job->ssdv_conf.quality];
+			record_size(&avg, packets);
+			job->stats->packets[job->ssdv_conf.res][job->ssdv_conf.quality] = avg;
+		}
+	} else { // No camera found
+		TRACE_INFO("IMG  > Encode/Transmit SSDV (no cam found) ID=%d", job->image_id);
+		encode_ssdv(noCameraFound, sizeof(noCameraFound), conf, job->image_id, job->ssdv_conf.quality, conf->ssdv_conf.redundantTx, false);
+	}
+}
+
 THD_FUNCTION(imgThread, arg)
 {
 	module_conf_t* conf = (module_conf_t*)arg;
@@ -557,6 +1312,27 @@ THD_FUNCTION(imgThread, arg)
 	if(conf->init_delay) chThdSleepMilliseconds(conf->init_delay);
 	TRACE_INFO("IMG  > Startup image thread");
 
+	// Pipelined mode: Split buffer for two images
+	bool pipelined = conf->ssdv_conf.pipeline && conf->trigger.type == TRIG_CONTINUOUSLY;
+	if(conf->ssdv_conf.pipeline && !pipelined)
+		TRACE_WARN("IMG  > Pipelined mode requires TRIG_CONTINUOUSLY");
+	static image_stats_t stats[sizeof(config)/sizeof(config[0])]; // Statistics per module
+	image_job_t jobs[2];
+	for(uint8_t i=0; i<2; i++) {
+		jobs[i].conf = conf;
+		jobs[i].stats = &stats[conf - config];
+		jobs[i].ssdv_conf = conf->ssdv_conf;
+		jobs[i].buffer = conf->ssdv_conf.ram_buffer;
+		jobs[i].size = conf->ssdv_conf.ram_size;
+		if(pipelined) {
+			uint32_t half = (conf->ssdv_conf.ram_size / 2) & ~(DMA_FIFO_BURST_ALIGN-1);
+			jobs[i].buffer = &conf->ssdv_conf.ram_buffer[i*half];
+			jobs[i].size = half;
+		}
+	}
+	uint8_t cur = 0;		// Image which is transmitted next
+	bool captured = false;	// jobs[cur] has been captured already
+
 	systime_t time = chVTGetSystemTimeX();
 	while(true)
 	{
@@ -566,16 +1342,33 @@ THD_FUNCTION(imgThread, arg)
 		if(!p_sleep(&conf->sleep_conf))
 		{
 			// Take picture
-			bool camera_found = takePicture(&conf->ssdv_conf, true);
-			gimage_id++; // Increase SSDV image counter
+			if(!captured)
+				capture_image(&jobs[cur]);
+
+			// Capture the next image while this one is transmitted. The camera is
+			// arbitrated by samplePicture() through camera_mtx. A normal capture
+			// locks the radio while its DMA samples, the radio pauses between two
+			// messages while this thread keeps encoding into the radio buffers. A
+			// streaming capture doesn't lock the radio, a DMA error caused by the
+			// transmission fails it and the image is sampled again.
+			// The capture thread needs about 3kb of stack, most of it for the
+			// ssdv_t (2kb) of stream_ssdv() or score_jpeg().
+			thread_t *th = NULL;
+			if(pipelined) {
+				th = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(4*1024), "IMC", NORMALPRIO, captureThread, &jobs[cur ^ 1]);
+				if(!th)
+					TRACE_WARN("IMG  > Could not start capture thread (not enough memory available)");
+			}
 
 			// Radio transmission
-			if(camera_found) {
-				TRACE_INFO("IMG  > Encode/Transmit SSDV ID=%d", gimage_id-1);
-				encode_ssdv(conf->ssdv_conf.ram_buffer, conf->ssdv_conf.size_sampled, conf, gimage_id-1, conf->ssdv_conf.redundantTx);
-			} else { // No camera found
-				TRACE_INFO("IMG  > Encode/Transmit SSDV (no cam found) ID=%d", gimage_id-1);
-				encode_ssdv(noCameraFound, sizeof(noCameraFound), conf, gimage_id-1, conf->ssdv_conf.redundantTx);
+			transmit_image(&jobs[cur]);
+			captured = false;
+
+			// Next image
+			if(th) {
+				chThdWait(th);
+				cur ^= 1;
+				captured = true;
 			}
 		}
 
@@ -586,7 +1379,11 @@ THD_FUNCTION(imgThread, arg)
 void start_image_thread(module_conf_t *conf)
 {
 	chsnprintf(conf->name, sizeof(conf->name), "IMG");
-	thread_t *th = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(conf->packet_spacing ? 6*1024 : 12*1024), "IMG", NORMALPRIO, imgThread, conf);
+	if(!conf->tx_priority)
+		conf->tx_priority = RADIO_PRIO_IMAGE;
+	if(!conf->tx_deadline)
+		conf->tx_deadline = RADIO_DEADLINE_IMAGE;
+	thread_t *th = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(7*1024), "IMG", NORMALPRIO, imgThread, conf);
 	if(!th) {
 		// Print startup error, do not start watchdog for this thread
 		TRACE_ERROR("IMG  > Could not startup thread (not enough memory available)");
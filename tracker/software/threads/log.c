@@ -122,6 +122,10 @@ void getNextLogTrackPoint(trackPoint_t* log)
 
 		// Read data from memory
 		flashRead(address, (char*)log, sizeof(trackPoint_t));
+		if(log->id != 0xFFFFFFFF && !isValidLogTrackPoint(log)) {
+			TRACE_ERROR("LOG  > Corrupted log entry (ADDR=%08x)", address);
+			log->id = 0xFFFFFFFF; // Skip entry
+		}
 
 	/* While the sequence has more values than the log has logs, we check if we
 	 * are inside the log-address-range. The Sequence has more IDs because it
@@ -152,10 +156,11 @@ THD_FUNCTION(logThread, arg)
 
 			// Encode radio message
 			radioMSG_t msg;
-			uint8_t buffer[512];
-			msg.buffer = buffer;
 			msg.freq = &conf->frequency;
 			msg.power = conf->power;
+			msg.priority = conf->tx_priority;
+			msg.deadline = conf->tx_deadline;
+			msg.preamble_len = 0;
 
 			switch(conf->protocol) {
 				case PROT_APRS_2GFSK:
@@ -169,7 +174,8 @@ THD_FUNCTION(logThread, arg)
 
 					// Encode and transmit log packet
 					ax25_t ax25_handle;
-					aprs_encode_init(&ax25_handle, buffer, sizeof(buffer), msg.mod);
+					msg.buffer = getRadioBuffer();
+					aprs_encode_init(&ax25_handle, msg.buffer, RADIO_BUFFER_SIZE, msg.mod);
 
 					for(uint8_t i=0; i<2; i++) { // Transmit two log packets
 						getNextLogTrackPoint(&log);
@@ -178,9 +184,10 @@ THD_FUNCTION(logThread, arg)
 					}
 
 					msg.bin_len = aprs_encode_finalize(&ax25_handle);
+					msg.preamble_len = ax25_handle.preamble;
 
 					// Transmit packet
-					transmitOnRadio(&msg, true);
+					transmitOnRadio(&msg, 0);
 					break;
 
 				default:
@@ -195,6 +202,10 @@ THD_FUNCTION(logThread, arg)
 void start_logging_thread(module_conf_t *conf)
 {
 	chsnprintf(conf->name, sizeof(conf->name), "LOG");
+	if(!conf->tx_priority)
+		conf->tx_priority = RADIO_PRIO_LOG;
+	if(!conf->tx_deadline)
+		conf->tx_deadline = RADIO_DEADLINE_LOG;
 	thread_t *th = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(2*1024), "LOG", NORMALPRIO, logThread, conf);
 	if(!th) {
 		// Print startup error, do not start watchdog for this thread
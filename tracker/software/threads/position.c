@@ -140,10 +140,11 @@ THD_FUNCTION(posThread, arg)
 			TRACE_INFO("POS  > Transmit position");
 
 			radioMSG_t msg;
-			uint8_t buffer[512];
-			msg.buffer = buffer;
 			msg.freq = &conf->frequency;
 			msg.power = conf->power;
+			msg.priority = conf->tx_priority;
+			msg.deadline = conf->tx_deadline;
+			msg.preamble_len = 0;
 
 			switch(conf->protocol) {
 
@@ -157,10 +158,12 @@ THD_FUNCTION(posThread, arg)
 					ax25_t ax25_handle;
 
 					// Encode and transmit position packet
-					aprs_encode_init(&ax25_handle, buffer, sizeof(buffer), msg.mod);
+					msg.buffer = getRadioBuffer();
+					aprs_encode_init(&ax25_handle, msg.buffer, RADIO_BUFFER_SIZE, msg.mod);
 					aprs_encode_position(&ax25_handle, &(conf->aprs_conf), trackPoint); // Encode packet
 					msg.bin_len = aprs_encode_finalize(&ax25_handle);
-					transmitOnRadio(&msg, true);
+					msg.preamble_len = ax25_handle.preamble;
+					transmitOnRadio(&msg, 0);
 
 					// Telemetry encoding parameter transmission
 					if(conf->aprs_conf.tel_enc)
@@ -180,10 +183,12 @@ THD_FUNCTION(posThread, arg)
 							const telemetry_conf_t tel_conf[] = {CONF_PARM, CONF_UNIT, CONF_EQNS, CONF_BITS};
 
 							// Encode and transmit telemetry config packet
-							aprs_encode_init(&ax25_handle, buffer, sizeof(buffer), msg.mod);
+							msg.buffer = getRadioBuffer();
+							aprs_encode_init(&ax25_handle, msg.buffer, RADIO_BUFFER_SIZE, msg.mod);
 							aprs_encode_telemetry_configuration(&ax25_handle, &conf->aprs_conf, tel_conf[current_conf_count]);
 							msg.bin_len = aprs_encode_finalize(&ax25_handle);
-							transmitOnRadio(&msg, true);
+							msg.preamble_len = ax25_handle.preamble;
+							transmitOnRadio(&msg, 0);
 
 							current_conf_count++;
 						}
@@ -200,10 +205,11 @@ THD_FUNCTION(posThread, arg)
 					memcpy(fskmsg, conf->ukhas_conf.format, sizeof(conf->ukhas_conf.format));
 					replace_placeholders(fskmsg, sizeof(fskmsg), trackPoint);
 					str_replace(fskmsg, sizeof(fskmsg), "<CALL>", conf->ukhas_conf.callsign);
-					msg.bin_len = 8*chsnprintf((char*)buffer, sizeof(buffer), "$$$$$%s*%04X\n", fskmsg, crc16(fskmsg));
+					msg.buffer = getRadioBuffer();
+					msg.bin_len = 8*chsnprintf((char*)msg.buffer, RADIO_BUFFER_SIZE, "$$$$$%s*%04X\n", fskmsg, crc16(fskmsg));
 
 					// Transmit message
-					transmitOnRadio(&msg, true);
+					transmitOnRadio(&msg, 0);
 					break;
 
 				case PROT_MORSE: // Encode Morse
@@ -217,8 +223,9 @@ THD_FUNCTION(posThread, arg)
 					str_replace(morse, sizeof(morse), "<CALL>", conf->morse_conf.callsign);
 
 					// Transmit message
-					msg.bin_len = morse_encode(buffer, sizeof(buffer), morse); // Convert message to binary stream
-					transmitOnRadio(&msg, true);
+					msg.buffer = getRadioBuffer();
+					msg.bin_len = morse_encode(msg.buffer, RADIO_BUFFER_SIZE, morse); // Convert message to binary stream
+					transmitOnRadio(&msg, 0);
 					break;
 
 				default:
@@ -233,6 +240,10 @@ THD_FUNCTION(posThread, arg)
 void start_position_thread(module_conf_t *conf)
 {
 	chsnprintf(conf->name, sizeof(conf->name), "POS");
+	if(!conf->tx_priority)
+		conf->tx_priority = RADIO_PRIO_POSITION;
+	if(!conf->tx_deadline)
+		conf->tx_deadline = RADIO_DEADLINE_POSITION;
 	thread_t *th = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(5*1024), "POS", NORMALPRIO, posThread, conf);
 	if(!th) {
 		// Print startup error, do not start watchdog for this thread
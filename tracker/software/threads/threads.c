@@ -5,6 +5,7 @@
 #include "watchdog.h"
 #include "pi2c.h"
 #include "pac1720.h"
+#include "radio.h"
 
 systime_t watchdog_tracking;
 
@@ -12,6 +13,7 @@ void start_essential_threads(void) {
 	init_watchdog();				// Init watchdog
 	pi2cInit();						// Initialize I2C
 	pac1720_init();					// Initialize current measurement
+	initRadioManager();				// Initialize radio buffers and radio manager
 	init_tracking_manager(false);	// Initialize tracking manager (without GPS, GPS is initialized if needed by position thread)
 	chThdSleepMilliseconds(300);	// Wait for tracking manager to initialize
 }
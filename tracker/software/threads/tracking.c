@@ -13,6 +13,7 @@
 #include "flash.h"
 #include "watchdog.h"
 #include "pi2c.h"
+#include "pcrc.h"
 
 static trackPoint_t trackPoints[2];
 static trackPoint_t* lastTrackPoint;
@@ -55,8 +56,26 @@ static trackPoint_t* getNextFreeLogAddress(void)
 }
 
 /**
-  * Returns next free log entry address in memory. Returns 0 if all cells are
-  * filled with data
+  * Checks the CRC of a track point read from the log
+  */
+bool isValidLogTrackPoint(trackPoint_t* tp)
+{
+	return tp->version == TRACKPOINT_VERSION && tp->crc == crc32(tp, offsetof(trackPoint_t, crc));
+}
+
+/**
+  * Sets version and CRC of a complete track point. It must not be changed
+  * afterwards.
+  */
+static void finalizeTrackPoint(trackPoint_t* tp)
+{
+	tp->version = TRACKPOINT_VERSION;
+	tp->crc = crc32(tp, offsetof(trackPoint_t, crc));
+}
+
+/**
+  * Returns most recent valid log entry in memory. Returns NULL if there is no
+  * valid log entry.
   */
 static trackPoint_t* getLastLog(void)
 {
@@ -65,11 +84,12 @@ static trackPoint_t* getLastLog(void)
 	for(uint16_t i=0; (tp = getLogBuffer(i)) != NULL; i++) {
 		if(tp->id == 0xFFFFFFFF)
 			return last; // Found last entry
-		last = tp;
+		if(isValidLogTrackPoint(tp))
+			last = tp;
+		else
+			TRACE_ERROR("TRAC > Corrupted log entry (ADDR=%08x)", tp);
 	}
-	if(last->id != 0xFFFFFFFF)
-		return last; // All memory entries are use, so the very last one must be the most recent one.
-	return NULL; // There is no log entry in memory
+	return last; // All memory entries are used, so the very last valid one must be the most recent one.
 }
 
 /**
@@ -120,6 +140,47 @@ static void writeLogTrackPoint(trackPoint_t* tp)
 		TRACE_ERROR("TRAC > Flash write failed");
 }
 
+/**
+  * Converts a log written by a firmware with version 0 track points (72 bytes
+  * without CRC), which would be read at the wrong stride. The most recent
+  * entry is kept to continue the reset counter and the position, the sectors
+  * holding version 0 entries are erased.
+  */
+static void migrateLog(void)
+{
+	const uint32_t sectors[] = {LOG_FLASH_ADDR1, LOG_FLASH_ADDR2};
+	trackPoint_t last, tp;
+	bool found = false;
+
+	for(uint8_t i=0; i<sizeof(sectors)/sizeof(sectors[0]); i++)
+	{
+		// Empty sector or current format
+		flashRead(sectors[i], (char*)&tp, sizeof(trackPoint_t));
+		if(tp.id == 0xFFFFFFFF || tp.version == TRACKPOINT_VERSION)
+			continue;
+
+		// Find most recent entry
+		for(uint32_t addr = sectors[i]; addr + TRACKPOINT_V0_SIZE <= sectors[i] + LOG_SECTOR_SIZE; addr += TRACKPOINT_V0_SIZE)
+		{
+			flashRead(addr, (char*)&tp, TRACKPOINT_V0_SIZE);
+			if(tp.id == 0xFFFFFFFF)
+				break;
+			if(!found || tp.reset > last.reset || (tp.reset == last.reset && tp.id > last.id)) {
+				memcpy(&last, &tp, TRACKPOINT_V0_SIZE);
+				found = true;
+			}
+		}
+
+		TRACE_WARN("TRAC > Erase flash %08x (log of old format)", sectors[i]);
+		flashErase(sectors[i], LOG_SECTOR_SIZE);
+	}
+
+	if(found) {
+		finalizeTrackPoint(&last);
+		writeLogTrackPoint(&last);
+	}
+}
+
 void waitForNewTrackPoint(void)
 {
 	uint32_t old_id = getLastTrackPoint()->id;
@@ -304,6 +365,7 @@ THD_FUNCTION(trackingThread, arg) {
 
 	// Get last tracking point from memory
 	TRACE_INFO("TRAC > Read last track point from flash memory");
+	migrateLog();
 	trackPoint_t* lastLogPoint = getLastLog();
 
 	if(lastLogPoint != NULL) { // If there has been stored a trackpoint, then get the last know GPS fix
@@ -340,6 +402,7 @@ THD_FUNCTION(trackingThread, arg) {
 	measureVoltage(lastTrackPoint);
 	getSensors(lastTrackPoint);
 	setSystemStatus(lastTrackPoint);
+	finalizeTrackPoint(lastTrackPoint);
 
 	// Write Trackpoint to Flash memory
 	writeLogTrackPoint(lastTrackPoint);
@@ -365,6 +428,7 @@ THD_FUNCTION(trackingThread, arg) {
 		measureVoltage(tp);
 		getSensors(tp);
 		setSystemStatus(tp);
+		finalizeTrackPoint(tp);
 
 		// Trace data
 		unixTimestamp2Date(&time, tp->gps_time);
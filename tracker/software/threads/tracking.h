@@ -6,6 +6,9 @@
 #include "ptime.h"
 
 
+#define TRACKPOINT_VERSION		1		/* Track point with CRC (version 0: 72 bytes without CRC) */
+#define TRACKPOINT_V0_SIZE		72		/* Size of a version 0 track point in the log */
+
 #define BME_STATUS_BITS         2
 #define BME_STATUS_MASK         0x3
 #define BME_OK_VALUE            0x0
@@ -69,7 +72,7 @@ typedef struct {
 	uint8_t sen_e1_hum;			// Rel. humidity in %
 	uint8_t sen_e2_hum;			// Rel. humidity in %
 
-	uint8_t dummy2;
+	uint8_t version;		// Record format (TRACKPOINT_VERSION)
 
 	int16_t stm32_temp;
 	int16_t si4464_temp;
@@ -92,11 +95,14 @@ typedef struct {
                        * - 10:11 BMEe1 status (0 = OK, 1 = Fail, 2 = Not fitted)
                        * - 12:13 BMEe2 status (0 = OK, 1 = Fail, 2 = Not fitted)
                        */
+
+	uint32_t crc;			// CRC32 of all fields above (set when the track point is complete)
 } trackPoint_t;
 
 void waitForNewTrackPoint(void);
 trackPoint_t* getLastTrackPoint(void);
 void getNextLogTrackPoint(trackPoint_t* log);
+bool isValidLogTrackPoint(trackPoint_t* tp);
 void init_tracking_manager(bool useGPS);
 trackPoint_t* getLogBuffer(uint16_t id);
 
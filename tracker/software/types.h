@@ -43,6 +43,7 @@ typedef struct {
 	uint16_t symbol;			// APRS symbol
 	char path[16];				// APRS path
 	uint16_t preamble;			// Preamble in milliseconds
+	uint8_t fx25;				// FX.25 check bytes (0: AX.25 only, 16, 32 or 64)
 	telemetry_t tel[5];			// Telemetry types
 	bool tel_enc;				// Transmit telemetry encoding information
 	uint16_t tel_enc_cycle;		// Telemetry encoding cycle in seconds
@@ -101,6 +102,9 @@ typedef struct { // Radio message type
 	uint32_t		bin_len;		// Binary length (it bits)
 	int8_t			power;			// Power in dBm
 	mod_t			mod;			// Modulation
+	uint32_t		preamble_len;	// Preamble length (in bits) which can be skipped if appended to another message
+	uint8_t			priority;		// Scheduling priority (higher is transmitted first)
+	uint32_t		deadline;		// Max. time (in ms) the message should wait for the radio
 
 	freq_conf_t*	freq;			// Frequency
 
@@ -116,7 +120,8 @@ typedef enum {
 	RES_VGA,
 	RES_XGA,
 	RES_UXGA,
-	RES_MAX
+	RES_MAX,
+	RES_AUTO
 } resolution_t;
 
 typedef struct {
@@ -126,7 +131,17 @@ typedef struct {
 	uint8_t *ram_buffer;	// Camera Buffer
 	uint32_t ram_size;		// Size of buffer
 	uint32_t size_sampled;	// Actual image data size (do not set in config)
+	uint8_t score;			// Score of the sampled image 0-100 (do not set in config)
 	bool redundantTx;		// Redundand packet transmission (APRS only)
+	uint8_t parity_group;	// SSDV packets per parity packet (APRS only, 0: no parity packets)
+	bool stream;			// Encode SSDV while sampling (ram_buffer holds SSDV packets instead of the JPEG)
+	bool pipeline;			// Capture the next image while transmitting (TRIG_CONTINUOUSLY only, splits ram_buffer in two)
+	bool match_dqt;			// Program the camera quantization to the SSDV quality (saves requantization, exact at quality 4)
+	uint8_t burst;			// Frames captured per image, only the best one is transmitted (0 or 1: single frame)
+	uint8_t min_score;		// Frames scoring lower (0-100) are not transmitted (burst only)
+	uint8_t thumbnail;		// Transmit a thumbnail before the image (0: off, 1: 1/8, 2: 1/4, 4: 1/2 scale)
+	bool progressive;		// Transmit the packets spread over the image (an interrupted transmission leaves gaps instead of a missing bottom)
+	uint16_t airtime;		// Maximum transmission time per image in seconds (RES_AUTO only, 0: no limit)
 } ssdv_conf_t;
 
 typedef enum {
@@ -164,6 +179,8 @@ typedef struct {
 	int8_t				power;
 	freq_conf_t			frequency;
 	prot_t				protocol;
+	uint8_t				tx_priority;
+	uint32_t			tx_deadline;
 
 	// Timing
 	uint32_t			init_delay;